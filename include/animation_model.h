@@ -15,6 +15,7 @@ public:
     void stop_animation();
 
     void draw(Renderer& renderer);
+    const AABB& get_bound() const { return model->get_bound(); }
 private:
     PModel model;
 
@@ -0,0 +1,41 @@
+#ifndef DSPROJECT_BENCHMARK_H
+#define DSPROJECT_BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+/* reproducible rendering benchmark, started with --bench-render
+ *
+ * renders a map generated from a fixed seed in a hidden window while the camera flies through the
+ * centers of the rooms at a constant speed, then writes the p50/p95/p99 of the frame time and of
+ * every render pass timer to a JSON file. animations and particles advance with a fixed time step,
+ * physics and AI do not run so that every run sees the same scene. */
+class RenderBenchmark {
+public:
+    static const unsigned int MAP_SEED = 20161216;
+
+    RenderBenchmark(int frames, int warmup_frames, const std::string& output);
+
+    void run();
+
+private:
+    static const float FRAME_TIME;
+    static const float EYE_HEIGHT;
+
+    int frames;
+    int warmup_frames;
+    std::string output;
+
+    std::vector<glm::vec3> path;
+    /* distance along the path at each point */
+    std::vector<float> path_distance;
+
+    void build_path();
+    glm::vec3 sample_path(float t, glm::vec3& direction) const;
+
+    static double percentile(std::vector<double> samples, double p);
+    void write_results(const std::vector<double>& frame_times) const;
+};
+
+#endif
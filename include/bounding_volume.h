@@ -0,0 +1,45 @@
+#ifndef DSPROJECT_BOUNDING_VOLUME_H
+#define DSPROJECT_BOUNDING_VOLUME_H
+
+#include <glm/glm.hpp>
+
+/* axis-aligned bounding box, empty until a point is added */
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    AABB();
+    AABB(const glm::vec3& min, const glm::vec3& max);
+
+    bool is_empty() const { return min.x > max.x; }
+    glm::vec3 get_center() const { return (min + max) * 0.5f; }
+    glm::vec3 get_extents() const { return (max - min) * 0.5f; }
+
+    void expand(const glm::vec3& point);
+    void expand(const AABB& box);
+    /* scale the box about its center */
+    void scale(float factor);
+
+    /* bound of this box after an affine transform */
+    AABB transform(const glm::mat4& m) const;
+    bool intersects(const glm::vec3& center, float radius) const;
+};
+
+/* the six planes of a view volume, normals pointing inwards */
+class Frustum {
+public:
+    /* a default frustum contains everything */
+    Frustum();
+    /* extract the planes from a view-projection matrix */
+    explicit Frustum(const glm::mat4& vp);
+    /* a half space n.x + w >= 0, all six planes are the same */
+    explicit Frustum(const glm::vec4& plane);
+
+    bool intersects(const AABB& box) const;
+    bool intersects(const glm::vec3& center, float radius) const;
+
+private:
+    glm::vec4 planes[6];
+};
+
+#endif
@@ -24,10 +24,15 @@ public:
 	virtual void draw(Renderer& renderer) override;
 	virtual void update(float dt) { }
 
+	glm::mat4 get_model_matrix() const;
+	/* world space bound of the model, empty for characters without one */
+	AABB get_bound() const;
+
 protected:
     void init_model();
     virtual AnimationModel* load_model() const = 0;
-	virtual void intrinsic_transform(Renderer&) { }
+	/* transform from the model space of the asset to the local space of the character */
+	virtual glm::mat4 intrinsic_transform() const { return glm::mat4(); }
 
     AnimationModel* model;
 };
@@ -96,7 +101,7 @@ class SkeletonCharacter : public RigidCharacter {
 private:
     static PModel _prepare_model();
     virtual AnimationModel* load_model() const override;
-	virtual void intrinsic_transform(Renderer& renderer);
+	virtual glm::mat4 intrinsic_transform() const;
 	virtual btRigidBody* setup_rigid_body(const btTransform& trans);
 	bool bfs(glm::vec3 pos_s, glm::vec3 pos_f);
 
@@ -111,7 +116,7 @@ class TrapItem : public StaticCharacter {
 private:
 	static PModel _prepare_model();
 	virtual AnimationModel* load_model() const override;
-	virtual void intrinsic_transform(Renderer& renderer);
+	virtual glm::mat4 intrinsic_transform() const;
 
 	bool triggered;
 
@@ -125,7 +130,7 @@ class ChestTrapItem : public RigidCharacter {
 private:
 	static PModel _prepare_model();
 	virtual AnimationModel* load_model() const override;
-	virtual void intrinsic_transform(Renderer& renderer);
+	virtual glm::mat4 intrinsic_transform() const;
 	virtual btRigidBody* setup_rigid_body(const btTransform& trans);
 
 	bool triggered;
@@ -140,7 +145,7 @@ class TorchItem : public RigidCharacter {
 private:
 	static PModel _prepare_model();
 	virtual AnimationModel* load_model() const override;
-	virtual void intrinsic_transform(Renderer& renderer);
+	virtual glm::mat4 intrinsic_transform() const;
 	virtual btRigidBody* setup_rigid_body(const btTransform& trans);
 
 public:
@@ -151,7 +156,7 @@ class BarrelItem : public RigidCharacter {
 private:
 	static PModel _prepare_model();
 	virtual AnimationModel* load_model() const override;
-	virtual void intrinsic_transform(Renderer& renderer);
+	virtual glm::mat4 intrinsic_transform() const;
 	virtual btRigidBody* setup_rigid_body(const btTransform& trans);
 
 public:
@@ -162,7 +167,7 @@ class ChestKeyItem : public RigidCharacter {
 private:
 	static PModel _prepare_model();
 	virtual AnimationModel* load_model() const override;
-	virtual void intrinsic_transform(Renderer& renderer);
+	virtual glm::mat4 intrinsic_transform() const;
 	virtual btRigidBody* setup_rigid_body(const btTransform& trans);
 
 	glm::vec3 pos;
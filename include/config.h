@@ -35,6 +35,18 @@ extern int g_screen_width;
 extern int g_screen_height;
 extern bool g_fullscreen;
 extern int g_MSAA;
+extern int g_shadow_atlas_size;
+extern int g_shadow_lights;
+extern Renderer::ShadowTechnique g_shadow_technique;
+extern int g_ssao_scale;
+extern int g_ssao_samples;
+extern int g_bloom_mips;
+extern int g_bloom_iterations;
+extern bool g_bloom;
+extern bool g_fxaa;
+extern bool g_vignette;
+extern bool g_gpu_timers;
+extern std::string g_gpu_timer_dump;
 extern std::string g_font;
 
 #endif //DSPROJECT_CONFIG_H
@@ -16,6 +16,12 @@ public:
 
     virtual void enter() { }
     virtual void exit() { }
+
+    /* screens without a 3D view, the main loop then only wakes up for input and skips the
+     * simulation and the 3D passes */
+    virtual bool is_static() const { return false; }
+    /* true if the view changed since the last call */
+    virtual bool poll_redraw() { return true; }
 };
 
 class GameController : public Controller {
@@ -42,6 +48,11 @@ public:
     virtual void handle_key(int key, int scancode, int action, int mode) override;
     virtual void handle_mouse(double xpos, double ypos) override;
 
+    virtual void enter() override { view_dirty = true; }
+
+    virtual bool is_static() const override { return true; }
+    virtual bool poll_redraw() override;
+
 protected:
     WidgetController(const std::string& bg);
 
@@ -51,6 +62,7 @@ private:
     POverlay background;
     float layout_y;
     std::vector<PGUIWidget> widgets;
+    bool view_dirty;
 };
 
 class MainMenuController : public WidgetController {
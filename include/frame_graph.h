@@ -0,0 +1,139 @@
+#ifndef DSPROJECT_FRAME_GRAPH_H
+#define DSPROJECT_FRAME_GRAPH_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <functional>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class GPUProfiler;
+class GLState;
+
+/* a graph of the render passes of one frame
+ *
+ * passes are added in execution order and declare the textures they read and write. compile()
+ * culls the passes whose results are never used, computes the lifetime of every transient
+ * texture and assigns physical textures from a pool so that transients with the same
+ * description and disjoint lifetimes share memory. each pass renders into a framebuffer made of
+ * the textures it writes, color targets in declaration order and depth targets as the depth
+ * attachment, so a pass can keep depth testing against a depth buffer written earlier. */
+class FrameGraph {
+public:
+    typedef int Resource;
+
+    struct TextureDesc {
+        int width;
+        int height;
+        GLenum format;
+        GLenum filter;
+
+        TextureDesc(int width = 0, int height = 0, GLenum format = GL_RGBA8, GLenum filter = GL_NEAREST) :
+            width(width), height(height), format(format), filter(filter) { }
+
+        bool operator==(const TextureDesc& rhs) const
+        {
+            return width == rhs.width && height == rhs.height && format == rhs.format && filter == rhs.filter;
+        }
+    };
+
+    /* handed to the setup function of a pass to declare its resources */
+    class PassBuilder {
+    public:
+        /* a new transient texture written by this pass */
+        Resource create(const std::string& name, const TextureDesc& desc);
+        Resource read(Resource resource);
+        Resource write(Resource resource);
+        /* the pass has effects outside of the graph (e.g. the back buffer) and is never culled */
+        void side_effect();
+
+    private:
+        friend class FrameGraph;
+
+        FrameGraph& graph;
+        int pass;
+
+        PassBuilder(FrameGraph& graph, int pass) : graph(graph), pass(pass) { }
+    };
+
+    typedef std::function<void(PassBuilder&)> SetupFunc;
+    typedef std::function<void(const FrameGraph&)> ExecuteFunc;
+
+    /* binds of the graph go through the state cache of the renderer it draws for */
+    explicit FrameGraph(GLState& gl_state);
+
+    /* drop the passes and resources of the last frame, the texture pool is kept */
+    void reset(int back_buffer_width, int back_buffer_height);
+
+    /* a texture owned outside of the graph */
+    Resource import_texture(const std::string& name, GLuint texture, const TextureDesc& desc);
+
+    /* setup runs immediately, execute runs in execute() with the pass framebuffer and viewport bound */
+    void add_pass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute);
+
+    void compile();
+    /* passes are timed under their names if a profiler is given */
+    void execute(GPUProfiler* profiler = nullptr);
+
+    GLuint get_texture(Resource resource) const;
+    const TextureDesc& get_desc(Resource resource) const { return resources[resource].desc; }
+
+    size_t get_num_passes() const { return passes.size(); }
+    size_t get_num_culled() const { return num_culled; }
+    size_t get_num_textures() const { return pool.size(); }
+
+private:
+    struct ResourceNode {
+        std::string name;
+        TextureDesc desc;
+        GLuint texture;
+        bool imported;
+        /* passes writing the resource */
+        std::vector<int> writers;
+        int ref_count;
+        /* first and last pass using the resource after culling */
+        int first_use;
+        int last_use;
+    };
+
+    struct PassNode {
+        std::string name;
+        std::vector<Resource> reads;
+        std::vector<Resource> writes;
+        bool side_effect;
+        int ref_count;
+        bool culled;
+        GLuint fbo;
+        ExecuteFunc execute;
+    };
+
+    struct PooledTexture {
+        TextureDesc desc;
+        GLuint texture;
+        bool used;
+        /* owned by a transient resource of the pass being allocated */
+        bool busy;
+    };
+
+    GLState& gl_state;
+    std::vector<ResourceNode> resources;
+    std::vector<PassNode> passes;
+    size_t num_culled;
+    glm::ivec2 back_buffer_size;
+
+    std::vector<PooledTexture> pool;
+    std::map<std::vector<GLuint>, GLuint> fbo_cache;
+
+    static bool is_depth_format(GLenum format);
+
+    void cull_passes();
+    void compute_lifetimes();
+    void allocate_textures();
+    GLuint acquire_texture(const TextureDesc& desc);
+    void release_texture(GLuint texture);
+    GLuint get_framebuffer(const PassNode& pass);
+    void trim_pool();
+};
+
+#endif
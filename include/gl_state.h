@@ -0,0 +1,88 @@
+#ifndef DSPROJECT_GL_STATE_H
+#define DSPROJECT_GL_STATE_H
+
+#include <glad/glad.h>
+
+/* shadow copy of the GL state the renderer changes most often
+ *
+ * binds and enables that would not change anything are dropped before they reach the driver.
+ * every change of the tracked state has to go through this layer, including the binds done while
+ * creating objects, otherwise the shadow copy goes stale. objects that are deleted while bound
+ * revert the binding to 0 in GL and have to be forgotten here. state that is not tracked (an
+ * unknown cap or texture target) is passed through. */
+class GLState {
+public:
+    static const int MAX_TEXTURE_UNITS = 16;
+
+    GLState();
+
+    void use_program(GLuint program);
+    void bind_vertex_array(GLuint vao);
+    void bind_framebuffer(GLenum target, GLuint fbo);
+    /* the bound draw framebuffer, only asks GL when the shadow copy does not know it */
+    GLuint get_draw_framebuffer();
+
+    void active_texture(GLenum unit);
+    /* binds to the active unit like glBindTexture */
+    void bind_texture(GLenum target, GLuint texture);
+
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void blend_func(GLenum src, GLenum dst);
+
+    void forget_texture(GLuint texture);
+    void forget_framebuffer(GLuint fbo);
+    /* assume nothing about the current state, e.g. after foreign code touched the context */
+    void invalidate();
+
+    /* calls issued and dropped since the last begin_frame() and in the frame before */
+    void begin_frame();
+    unsigned int get_issued_calls() const { return last_issued; }
+    unsigned int get_filtered_calls() const { return last_filtered; }
+
+private:
+    enum TextureTarget {
+        TARGET_2D,
+        TARGET_CUBE_MAP,
+        TARGET_BUFFER,
+        TARGET_2D_ARRAY,
+        NUM_TEXTURE_TARGETS,
+    };
+
+    enum Cap {
+        CAP_BLEND,
+        CAP_DEPTH_TEST,
+        CAP_CULL_FACE,
+        CAP_SCISSOR_TEST,
+        CAP_CLIP_DISTANCE0,
+        CAP_MULTISAMPLE,
+        NUM_CAPS,
+    };
+
+    enum CapState {
+        CAP_UNKNOWN,
+        CAP_ENABLED,
+        CAP_DISABLED,
+    };
+
+    GLuint program;
+    GLuint vao;
+    GLuint draw_fbo;
+    GLuint read_fbo;
+    GLenum active_unit;
+    GLuint textures[MAX_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+    CapState caps[NUM_CAPS];
+    GLenum blend_src, blend_dst;
+
+    unsigned int issued, filtered;
+    unsigned int last_issued, last_filtered;
+
+    static int get_target_index(GLenum target);
+    static int get_cap_index(GLenum cap);
+
+    /* true if the call has to be issued */
+    bool update(GLuint& current, GLuint value);
+    void set_cap(GLenum cap, bool enabled);
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef DSPROJECT_GPU_PROFILER_H
+#define DSPROJECT_GPU_PROFILER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+/* GPU time of the render passes measured with GL_TIME_ELAPSED queries
+ *
+ * queries of a frame are only read back QUERY_LATENCY - 1 frames later and only if the results
+ * are already available, so the CPU never waits for the GPU. scopes with the same name within
+ * one frame are summed and every timer keeps a window of its last per-frame times. */
+class GPUProfiler {
+public:
+    static const int QUERY_LATENCY = 3;
+    static const int WINDOW_SIZE = 64;
+
+    struct Timer {
+        std::string name;
+        /* milliseconds, ring buffer of the last WINDOW_SIZE frames */
+        std::vector<double> samples;
+        size_t next;
+        /* every per-frame time while history is kept */
+        std::vector<double> history;
+
+        double get_average() const;
+        double get_min() const;
+        double get_max() const;
+        double get_last() const;
+    };
+
+    GPUProfiler();
+
+    void set_enabled(bool enabled) { this->enabled = enabled; }
+    bool is_enabled() const { return enabled; }
+
+    void set_keep_history(bool keep_history) { this->keep_history = keep_history; }
+    void clear_history();
+
+    void begin_frame();
+
+    /* time the GL commands issued until end(), scopes must not overlap */
+    void begin(const std::string& name);
+    void end();
+
+    size_t get_num_timers() const { return timers.size(); }
+    const Timer& get_timer(size_t timer) const { return timers[timer]; }
+    /* sum of the averages of all timers */
+    double get_frame_time() const;
+
+    /* write the timers as JSON if the path ends with .json, CSV otherwise */
+    void dump(const std::string& path) const;
+
+private:
+    struct Query {
+        int timer;
+        GLuint query;
+    };
+
+    bool enabled;
+    bool keep_history;
+    unsigned int frame;
+    bool in_scope;
+
+    std::vector<Timer> timers;
+    std::map<std::string, int> timer_index;
+
+    /* queries issued in each of the last QUERY_LATENCY frames and the query objects they reuse */
+    std::vector<Query> frame_queries[QUERY_LATENCY];
+    std::vector<GLuint> query_pool[QUERY_LATENCY];
+
+    int get_timer_index(const std::string& name);
+    void collect(int slot);
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include "renderable.h"
 #include "text_overlay.h"
 #include "material.h"
+#include "overlay_batch.h"
 
 #include <string>
 #include <functional>
@@ -14,22 +15,23 @@ public:
 
     GUIWidget(float left, float top, float width, float height);
 
-    static void setup_gui();
-
     float get_width() const { return width; }
     float get_height() const { return height; }
 
-    virtual void set_width(float w) { width = w; }
-    virtual void set_height(float h) { height = h; }
-    virtual void set_left(float l) { left = l; }
-    virtual void set_top(float t) { top = t; }
+    virtual void set_width(float w) { if (w != width) { width = w; geometry_dirty = true; } }
+    virtual void set_height(float h) { if (h != height) { height = h; geometry_dirty = true; } }
+    virtual void set_left(float l) { if (l != left) { left = l; geometry_dirty = true; } }
+    virtual void set_top(float t) { if (t != top) { top = t; geometry_dirty = true; } }
 
     virtual void set_enabled(bool enable) { }
-    virtual void handle_mouse(double xpos, double ypos) { }
+    /* true if the look of the widget changed */
+    virtual bool handle_mouse(double xpos, double ypos) { return false; }
     virtual void set_on_click_listener(OnClickListener listener) { }
 
 protected:
     float left, top, width, height;
+    /* the cached quads of the widget no longer match its rectangle */
+    bool geometry_dirty;
 
     bool hit_test(double xpos, double ypos);
 };
@@ -52,7 +54,7 @@ public:
 
     virtual void set_left(float l);
     virtual void set_top(float t);
-    virtual void set_mask_width(float mw) { mask_width = mw; }
+    virtual void set_mask_width(float mw) { if (mw != mask_width) { mask_width = mw; geometry_dirty = true; } }
     void set_text(const std::string& text) { this->text->set_text(text); }
     void set_color(glm::vec3 color) { this->text->set_color(color); }
 
@@ -61,12 +63,14 @@ public:
     }
     virtual void set_on_click_listener(OnClickListener listener) { this->on_click_listener = listener; }
 
-    virtual void handle_mouse(double xpos, double ypos) override;
+    virtual bool handle_mouse(double xpos, double ypos) override;
 private:
     std::shared_ptr<TextOverlay> text;
     PMaterialTexture background;
 
     float mask_width;
+    /* background quad, rebuilt when the rectangle or the mask width changes */
+    GLfloat background_vertices[6][OverlayBatch::VERTEX_FLOATS];
 
     bool enabled;
     enum {
@@ -12,6 +12,8 @@ struct Light {
     glm::vec3 color;
     float linear;
     float quadratic;
+    /* distance at which the contribution becomes negligible */
+    float radius;
 
     Light(const glm::vec3& position, const glm::vec3& color, float Ld, float Qd)
     {
@@ -19,6 +21,7 @@ struct Light {
         this->color = color;
         linear = Ld;
         quadratic = Qd;
+        radius = 0.0f;
     }
 };
 
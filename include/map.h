@@ -15,9 +15,14 @@ public:
     Map(int width, int height);
 
     void draw(Renderer& renderer);
+    virtual bool is_static() const override { return true; }
     static const float TILE_SIZE;
 
 	char get_tile(int i, int j) { return generator.getTile(i, j); }
+    /* change a tile at run time, the minimap picks it up on its next draw while the static map
+     * mesh is left as it is */
+    void set_tile(int i, int j, char tile);
+    const std::vector<MapGenerator::Rect>& get_rooms() const { return generator.get_rooms(); }
 private:
 
     int width, height;
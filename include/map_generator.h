@@ -46,6 +46,9 @@ public:
 public:
     MapGenerator(int width, int height);
 
+    /* replace the nondeterministic seed of all generators, e.g. for benchmarks */
+    static void seed(unsigned int value);
+
     void generate(int maxFeatures, Difficulty h);
 
     void print();
@@ -54,6 +57,9 @@ public:
 
     bool set_torch(int x, int y, char dir);
 
+    /* every room placed, in placement order */
+    const std::vector<Rect>& get_rooms() const { return _all_rooms; }
+
 private:
     bool createFeature();
 
@@ -67,6 +73,7 @@ private:
     int _width, _height;
     std::vector<char> _tiles;
     std::vector<Rect> _rooms; // rooms for place stairs or monsters
+    std::vector<Rect> _all_rooms; // rooms are removed from _rooms once an object is placed
     std::vector<Rect> _exits; // 4 sides of rooms or corridors
 };
 
@@ -30,7 +30,11 @@ public:
     PMaterialTexture get_normal_map() const { return normal_map; }
     float get_metallic() const { return metallic; }
     float get_roughness() const { return roughness; }
+    int get_id() const { return id; }
 private:
+    static int next_id;
+
+    int id;
     PMaterialTexture diffuse_texture;
     PMaterialTexture normal_map;
     float roughness;
@@ -4,6 +4,7 @@
 #include "material.h"
 #include "renderable.h"
 #include "intern_string.h"
+#include "bounding_volume.h"
 
 #include <string>
 #include <vector>
@@ -62,6 +63,9 @@ public:
 
     glm::mat4 global_transform_inverse;
 
+    /* bind pose bound in model space, enlarged for skinned meshes */
+    AABB bound;
+
     Mesh(aiNode* scene_root, const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, PMaterial material,
          const BoneMapping& bones, const glm::mat4& global_transform_inverse);
 
@@ -89,8 +93,10 @@ public:
 
     aiAnimation* get_animation(InternString name) const;
     std::vector<Mesh>& get_meshes() { return meshes; }
+    const AABB& get_bound() const { return bound; }
 private:
     std::vector<Mesh> meshes;
+    AABB bound;
     std::vector<PMaterial> materials;
     std::string directory;
     std::map<InternString, aiAnimation*> animations;
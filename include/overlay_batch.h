@@ -0,0 +1,49 @@
+#ifndef DSPROJECT_OVERLAY_BATCH_H
+#define DSPROJECT_OVERLAY_BATCH_H
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+
+class Renderer;
+class MaterialTexture;
+
+/* vertices of all overlays of a frame, written into the stream buffer at the end of the frame
+ *
+ * sprites keep their submission order since widget backgrounds overlap, consecutive sprites with
+ * the same texture share one draw. text is drawn on top of all sprites with a single draw from
+ * the glyph atlas. a vertex is a screen position, texture coordinates and a color. */
+class OverlayBatch {
+public:
+    static const int VERTEX_FLOATS = 7;
+
+    OverlayBatch();
+
+    void setup();
+
+    void add_sprite(MaterialTexture* texture, const GLfloat* vertices, size_t num_vertices);
+    void add_text(const GLfloat* vertices, size_t num_vertices);
+
+    /* draws issued by the last flush */
+    int get_num_draws() const { return num_draws; }
+
+    void flush(Renderer& renderer);
+
+private:
+    struct Run {
+        MaterialTexture* texture;
+        GLint first;
+        GLsizei count;
+    };
+
+    GLuint VAO;
+    /* generation of the stream buffer storage the VAO points at */
+    unsigned int stream_generation;
+
+    std::vector<GLfloat> sprite_vertices;
+    std::vector<GLfloat> text_vertices;
+    std::vector<Run> runs;
+    int num_draws;
+};
+
+#endif
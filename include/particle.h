@@ -13,6 +13,7 @@ public:
 	virtual void draw(Renderer& renderer) override;
 
 	void set_texture(PMaterialTexture tex) { texture = tex; }
+	AABB get_bound() const;
 private:
 	glm::vec3 pos;
 	GLuint vao;
@@ -0,0 +1,57 @@
+#ifndef DSPROJECT_PROFILER_H
+#define DSPROJECT_PROFILER_H
+
+/* CPU zone profiler, built only when _PROFILE_ is defined (cmake -DDSPROJECT_PROFILE=ON)
+ *
+ *   PROFILE_ZONE("name");
+ *
+ * times the rest of the enclosing scope. the name must be a string literal. zones are recorded
+ * into a fixed size ring buffer per thread, so the oldest zones are overwritten and recording
+ * never allocates. write_chrome_trace() exports the buffers as Chrome trace_event JSON which can
+ * be loaded in chrome://tracing. without _PROFILE_ the macro expands to nothing. */
+
+#ifdef _PROFILE_
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+class Profiler {
+public:
+    static const int RING_SIZE = 1 << 16;
+
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void record(const char* name, uint64_t begin, uint64_t end);
+
+    static bool write_chrome_trace(const std::string& path);
+};
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name(name), begin(Profiler::now()) { }
+    ~ProfileZone() { Profiler::record(name, begin, Profiler::now()); }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    uint64_t begin;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+
+#else
+
+#define PROFILE_ZONE(name)
+
+#endif
+
+#endif
@@ -16,6 +16,8 @@ public:
     static int random_int(int exclusiveMax);
     static int random_int(int min, int max); // inclusive min/max
     static bool random_bool(double probability = 0.5);
+    /* replace the nondeterministic seed, e.g. for benchmarks */
+    static void seed(unsigned int value);
 };
 
 #endif //DSPROJECT_RANDOM_UTILS_H_H
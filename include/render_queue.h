@@ -0,0 +1,89 @@
+#ifndef DSPROJECT_RENDER_QUEUE_H
+#define DSPROJECT_RENDER_QUEUE_H
+
+#include "material.h"
+
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+/* a queue of mesh draws recorded once per frame and replayed by the renderer passes
+ *
+ * every draw is submitted once and referenced by one command per pass. commands carry a 64-bit
+ * sort key (from MSB to LSB):
+ *   | pass (2) | shader (6) | material (16) | vao (16) | depth (24) |
+ * so that after sorting, commands of one pass are contiguous and draws sharing state are adjacent.
+ * adjacent commands that only differ in depth form a batch which is drawn with one instanced call */
+class RenderQueue {
+public:
+    enum Pass {
+        SHADOW_PASS = 0,
+        GEOMETRY_PASS = 1,
+        /* shadow casters that never move, only replayed when the shadow cache misses */
+        STATIC_SHADOW_PASS = 2,
+        NUM_PASSES,
+    };
+
+    struct DrawItem {
+        GLuint vao;
+        GLsizei index_count;
+        Material* material;
+
+        glm::mat4 model;
+        int bone_offset;
+    };
+
+    struct Command {
+        uint64_t key;
+        uint32_t draw;
+    };
+
+    /* a run of commands [first, first + count) sharing pass, shader, material and vao */
+    struct Batch {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    static uint64_t make_key(Pass pass, GLuint shader, int material, GLuint vao, float depth);
+
+    void clear();
+
+    /* append bone transforms to the per-frame palette, returns the offset of the first one */
+    int push_bones(GLsizei count, const GLfloat* transforms);
+    size_t get_num_bones() const { return bones.size(); }
+    const GLfloat* get_bones(int offset) const { return &bones[offset][0][0]; }
+
+    uint32_t push_draw(const DrawItem& draw);
+    void push_command(uint64_t key, uint32_t draw);
+
+    /* radix sort the commands by their keys and split them into batches */
+    void sort();
+
+    size_t get_num_commands() const { return commands.size(); }
+    const DrawItem& get_draw(size_t command) const { return draws[commands[command].draw]; }
+
+    size_t get_num_batches() const { return batches.size(); }
+    const Batch& get_batch(size_t batch) const { return batches[batch]; }
+    /* [begin, end) range of the batches of a pass, only valid after sort() */
+    void get_pass_batches(Pass pass, size_t& begin, size_t& end) const;
+    /* material field of the key, shadow passes store the atlas tile there as slot * 6 + face */
+    int get_batch_material(size_t batch) const;
+
+private:
+    static const int PASS_SHIFT = 62;
+    static const int SHADER_SHIFT = 56;
+    static const int MATERIAL_SHIFT = 40;
+    static const int VAO_SHIFT = 24;
+    static const uint64_t DEPTH_MASK = 0xffffff;
+
+    std::vector<DrawItem> draws;
+    std::vector<Command> commands;
+    std::vector<Command> sort_buffer;
+    std::vector<Batch> batches;
+    std::vector<glm::mat4> bones;
+
+    void build_batches();
+};
+
+#endif
@@ -11,6 +11,8 @@ public:
     virtual void draw(Renderer& renderer) = 0;
 
 	bool is_opaque() const { return opaque; }
+	/* static renderables never move, their shadows are cached */
+	virtual bool is_static() const { return false; }
 private:
 	bool opaque;
 };
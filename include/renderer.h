@@ -10,6 +10,13 @@
 #include "singleton.h"
 #include "light.h"
 #include "camera.h"
+#include "render_queue.h"
+#include "bounding_volume.h"
+#include "frame_graph.h"
+#include "gpu_profiler.h"
+#include "overlay_batch.h"
+#include "stream_buffer.h"
+#include "gl_state.h"
 
 #include <map>
 #include <stack>
@@ -22,9 +29,15 @@ class Renderable;
 using PRenderable = std::shared_ptr<Renderable>;
 class Overlay;
 using POverlay = std::shared_ptr<Overlay>;
+class Map;
 
 class Renderer : public Singleton<Renderer> {
 public:
+    enum class ShadowTechnique {
+        CUBE_MAP,
+        DUAL_PARABOLOID,
+    };
+
     Renderer();
 
     void set_viewport(int width, int height);
@@ -35,19 +48,34 @@ public:
     static const InternString GEOMETRY_PASS_SHADER;
     static const InternString LIGHTING_PASS_SHADER;
     static const InternString SSAO_SHADER;
-    static const InternString SSAO_BLUR_SHADER;
+    static const InternString SSAO_UPSAMPLE_SHADER;
     static const InternString DEPTH_MAP_SHADER;
-	static const InternString HDR_BLEND_SHADER;
+    static const InternString COMPOSITE_SHADER;
 	static const InternString GAUSSIAN_BLUR_SHADER;
+    static const InternString BLOOM_DOWNSAMPLE_SHADER;
+    static const InternString BLOOM_UPSAMPLE_SHADER;
 	static const InternString BILLBOARD_SHADER;
     static const InternString TEXT_OVERLAY_SHADER;
     static const InternString MINIMAP_SHADER;
     static const InternString GUI_SHADER;
+    static const InternString SCREEN_COPY_SHADER;
 
     static const GLuint DIFFUSE_TEXTURE_TARGET = GL_TEXTURE0;
     static const GLuint NORMAL_MAP_TARGET = GL_TEXTURE1;
+    static const GLuint INSTANCE_DATA_TARGET = GL_TEXTURE6;
+    static const GLuint BONE_PALETTE_TARGET = GL_TEXTURE7;
+    /* buffer textures of the lighting pass */
+    static const GLuint LIGHT_DATA_TARGET = GL_TEXTURE5;
+    static const GLuint CLUSTER_GRID_TARGET = GL_TEXTURE6;
+    static const GLuint LIGHT_INDEX_TARGET = GL_TEXTURE7;
+
+    static const int MAX_LIGHTS = 1024;
 
-    static const int MAX_LIGHTS = 32;
+    /* uniform block binding points */
+    static const GLuint FRAME_DATA_BINDING = 0;
+    static const GLuint DRAW_DATA_BINDING = 1;
+    static const GLuint SSAO_KERNEL_BINDING = 2;
+    static const GLuint SHADOW_DATA_BINDING = 3;
 
     void use_shader(InternString name);
     void uniform(ShaderProgram::UniformID id, float v0, float v1, float v2 = 0.0f, float v3 = 0.0f);
@@ -57,6 +85,9 @@ public:
 
     void begin_frame();
     void end_frame();
+    /* frame of a screen without a 3D view: the overlays are drawn into a cached texture only
+     * when redraw is set, otherwise the cache of the last frame is presented again */
+    void end_static_frame(bool redraw);
 
     void push_matrix();
     void pop_matrix();
@@ -64,39 +95,141 @@ public:
     template <typename T>
     void translate(T x, T y, T z) {
         model = glm::translate(model, glm::vec3(x, y, z));
-        update_mvp();
     }
 
     template <typename T>
     void rotate(T angle, T x, T y, T z) {
         model = glm::rotate(model, angle, glm::vec3(x, y, z));
-        update_mvp();
     }
 
     template <typename T>
     void scale(T x, T y, T z) {
         model = glm::scale(model, glm::vec3(x, y, z));
-        update_mvp();
+    }
+
+    void transform(const glm::mat4& m) {
+        model = model * m;
     }
 
     void add_light(const glm::vec3& position, const glm::vec3& color, float linear = 0.5f, float quadratic = 1.0f);
 
+    /* bone transforms used by the meshes submitted after this call */
+    void set_bone_transforms(GLsizei count, const GLfloat* transforms);
+    /* unskinned meshes share the identity palette at the start of the frame's bones */
+    void use_identity_bones() { bone_offset = 0; }
+    /* record a draw of the mesh with the current model matrix, bound is in model space */
+    void submit(GLuint vao, GLsizei index_count, Material* material, const AABB& bound);
+
+    /* world space bound tests against the camera and the shadow casting lights */
+    bool is_visible(const AABB& bound) const;
+    bool casts_shadow(const AABB& bound) const;
+
     void enqueue_renderable(PRenderable renderable);
     void enqueue_overlay(POverlay overlay);
 
     void toggle_minimap(bool st) { enable_minimap = st; }
+    /* redraw the whole minimap texture before it is shown next, for a new map */
+    void invalidate_minimap();
+    /* redraw the tile into the minimap texture before it is shown next */
+    void invalidate_minimap_tile(int i, int j);
+
+    GPUProfiler& get_gpu_profiler() { return gpu_profiler; }
+    OverlayBatch& get_overlay_batch() { return overlay_batch; }
+    StreamBuffer& get_stream_buffer() { return stream_buffer; }
+    GLState& get_gl_state() { return gl_state; }
 
 private:
     static const float Z_NEAR;
     static const float Z_FAR;
     static const float FOV;
 
-    static const int SHADOW_WIDTH = 2048;
-    static const int SHADOW_HEIGHT = 2048;
     static const float SHADOW_NEAR;
     static const float SHADOW_FAR;
+    static const int MAX_SHADOW_LIGHTS = 8;
+    /* six cube faces or two paraboloid hemispheres per light */
+    static const int MAX_SHADOW_FACES = 6;
+    static const int MIN_SHADOW_FACE_SIZE = 128;
+    static const int MAX_SHADOW_FACE_SIZE = 1024;
+
+    /* a shadow casting light and the face tiles it owns in the shadow atlas */
+    struct ShadowSlot {
+        int light;
+        int face_size;
+        glm::ivec2 face_offsets[MAX_SHADOW_FACES];
+        /* view-projection of the cube faces, view of the paraboloid hemispheres */
+        glm::mat4 transforms[MAX_SHADOW_FACES];
+        Frustum frustums[MAX_SHADOW_FACES];
+        /* static depth of the tiles is already in the static atlas */
+        bool cached;
+    };
+
+    /* a light in view ranked by the size of its lit region on screen */
+    struct ShadowCandidate {
+        int light;
+        float coverage;
+    };
+
+    /* std140 layouts of the uniform blocks */
+    struct FrameData {
+        glm::mat4 view;
+        glm::mat4 projection;
+        /* to reconstruct positions from the depth buffer */
+        glm::mat4 inv_view;
+        glm::mat4 inv_projection;
+        glm::vec4 view_pos;
+        /* x: tile size in pixels, y, z: scale and bias mapping log(view depth) to a depth slice */
+        glm::vec4 cluster_params;
+        /* x, y: screen tiles, z: depth slices, w: number of lights */
+        glm::ivec4 cluster_dims;
+    };
+
+    /* one per batch, x: index of the first instance of the batch in the instance buffer */
+    struct DrawData {
+        glm::ivec4 instance;
+    };
+
+    /* texels per instance in the instance buffer: model matrix and bone palette offset */
+    static const int INSTANCE_TEXELS = 5;
+
+    /* texels per light in the light buffer: position and radius, color, attenuation (linear, quadratic, flicker phase) */
+    static const int LIGHT_TEXELS = 3;
+
+    /* light clusters are screen tiles split into exponentially distributed depth slices */
+    static const int CLUSTER_TILE_SIZE = 64;
+    static const int CLUSTER_SLICES = 16;
+
+    /* inclusive range of clusters touched by the bounding box of a light */
+    struct ClusterRange {
+        GLuint light;
+        int min_x, max_x;
+        int min_y, max_y;
+        int min_z, max_z;
+    };
+    /* attenuation below which a light is ignored */
+    static const float LIGHT_CUTOFF;
+
+    static const int SSAO_KERNEL_SIZE = 64;
+
+    struct SSAOKernelBlock {
+        glm::vec4 samples[SSAO_KERNEL_SIZE];
+    };
+
+    struct ShadowData {
+        /* x: index of the light */
+        glm::ivec4 light;
+        /* atlas rectangle of each face in texture coordinates, offset and size */
+        glm::vec4 rects[MAX_SHADOW_FACES];
+        glm::mat4 transforms[MAX_SHADOW_FACES];
+    };
+
+    struct ShadowBlock {
+        glm::ivec4 num_shadows;
+        ShadowData shadows[MAX_SHADOW_LIGHTS];
+    };
 
     std::map<InternString, PShaderProgram> shaders;
+    /* drops redundant binds and enables, all of them go through GL_STATE */
+    GLState gl_state;
     PShaderProgram current_shader;
 
     glm::mat4 model;
@@ -104,64 +237,150 @@ private:
     glm::mat4 projection;
     std::stack<glm::mat4> xforms;
 	glm::vec3 view_pos;
+    Frustum view_frustum;
 
     std::vector<PRenderable> render_queue;
     std::vector<POverlay> overlay_queue;
 
-    std::vector<Light> lights;
-    int shadow_map_light_index;
+    RenderQueue command_queue;
+    int bone_offset;
+    bool submit_static;
 
-    GLuint gbuffer;
-    GLuint rbo_depth;
-    GLuint g_position;
-    GLuint g_normal;
-    GLuint g_albedo_spec;
+    GLuint instance_TBO;
+    GLuint instance_texture;
+    std::vector<glm::vec4> instance_data;
+    GLuint bone_TBO;
+    GLint max_texture_buffer_texels;
+    GLuint bone_texture;
+
+    GLuint frame_UBO;
+    GLuint draw_UBO;
+    GLsizeiptr draw_UBO_size;
+    GLsizeiptr draw_data_stride;
+    std::vector<char> draw_data;
+
+    std::vector<Light> lights;
+    GLuint light_TBO;
+    GLuint light_texture;
+    bool lights_dirty;
+
+    glm::ivec4 cluster_dims;
+    float cluster_scale;
+    /* offset and count into light_indices for each cluster */
+    std::vector<GLuint> cluster_grid;
+    std::vector<GLuint> light_indices;
+    /* scratch of build_clusters() */
+    std::vector<ClusterRange> cluster_ranges;
+    GLuint cluster_TBO;
+    GLuint cluster_texture;
+    GLuint light_index_TBO;
+    GLuint light_index_texture;
 
     GLuint quad_VAO;
     GLuint quad_VBO;
 
-    GLuint ssao_fbo;
-    GLuint ssao_blur_fbo;
     std::vector<glm::vec3> ssao_kernel;
+    GLuint ssao_kernel_UBO;
     GLuint ssao_noise_texture;
-    GLuint ssao_color_buffer;
-    GLuint ssao_color_buffer_blur;
-
-    GLuint depth_map_fbo;
-    GLuint depth_cubemap;
 
-	GLuint hdr_fbo;
-	GLuint hdr_buffers[2];
-	GLuint bloom_blur_fbo[2];
-	GLuint bloom_blur_buffers[2];
+    int num_shadow_faces;
+    /* scratch of select_shadow_lights() */
+    std::vector<ShadowCandidate> shadow_candidates;
+    /* lights casting shadows this frame */
+    std::vector<ShadowSlot> shadow_slots;
+    /* slots whose static depth is still intact in the static atlas */
+    std::vector<ShadowSlot> shadow_cache;
+    GLuint shadow_atlas_fbo;
+    GLuint shadow_atlas;
+    GLuint static_shadow_atlas_fbo;
+    GLuint static_shadow_atlas;
+    /* both atlases together hold the shadow_atlas_size^2 texel budget, each is half as tall as wide */
+    glm::ivec2 shadow_atlas_size;
+    /* rows of the atlas in use */
+    int shadow_atlas_height;
+    /* the atlas sampled by the lighting pass this frame */
+    GLuint shadow_map;
+    GLuint shadow_UBO;
+
+    /* passes of the frame and the transient render targets they use */
+    FrameGraph frame_graph;
+    GPUProfiler gpu_profiler;
+    OverlayBatch overlay_batch;
+    /* vertices written every frame */
+    StreamBuffer stream_buffer;
+
+    /* overlays of the last static frame */
+    GLuint overlay_cache_fbo;
+    GLuint overlay_cache_texture;
+    bool overlay_cache_valid;
 
     GLuint minimap_VAO;
-    GLuint minimap_VBO;
+    /* generation of the stream buffer storage the minimap VAO points at */
+    unsigned int minimap_stream_generation;
     bool enable_minimap;
-
-    void setup_gbuffer();
-    void update_mvp();
+    /* the tiles of the whole map, rasterized once and patched for the tiles that change */
+    GLuint minimap_fbo;
+    GLuint minimap_texture;
+    bool minimap_stale;
+    std::vector<glm::ivec2> minimap_dirty_tiles;
+
+    void setup_uniform_buffers();
+    void setup_instance_buffers();
+    void upload_frame_data();
+    void upload_draw_data();
+    void upload_lights();
+
+    void setup_clusters();
+    int get_cluster_slice(float depth) const;
+    void build_clusters();
+
+    void record_commands();
+    void replay_commands(RenderQueue::Pass pass);
+    void replay_batches(RenderQueue::Pass pass, size_t begin, size_t end);
+    void bind_material(Material* material);
 
     void setup_quad();
     void render_quad();
 
-    void render_lighting_pass();
+    void build_frame_graph();
+    FrameGraph::Resource add_bloom_passes(FrameGraph::Resource bright, int& num_levels);
+
+    void geometry_pass();
+    void render_lighting_pass(GLuint depth, GLuint normal, GLuint albedo_spec, GLuint ssao);
+    void forward_pass();
 
     void setup_SSAO();
-    void SSAO_pass();
+    void SSAO_pass(GLuint depth, GLuint normal);
+    void SSAO_upsample_pass(GLuint ssao, GLuint depth, GLuint normal);
 
     void setup_shadow_map();
+    GLuint create_shadow_atlas(GLuint fbo);
+    void select_shadow_lights();
+    bool pack_shadow_atlas();
+    void update_shadow_transforms(ShadowSlot& slot);
+    bool is_shadow_cached(const ShadowSlot& slot) const;
+    void cache_shadow_slot(const ShadowSlot& slot);
+    void invalidate_shadow_cache();
+    void upload_shadow_data();
+    void replay_shadow_faces(RenderQueue::Pass pass);
     void shadow_map_pass();
 
-	void setup_HDR();
-	void post_process_pass();
+    void bloom_downsample_pass(GLuint input, const glm::ivec2& input_size, bool first_level);
+    void gaussian_blur_pass(GLuint input, bool horizontal);
+    void bloom_upsample_pass(GLuint input, const glm::ivec2& input_size);
+    void post_process_pass(GLuint hdr, GLuint bloom, int bloom_levels);
+
+    void setup_overlay_cache();
 
     void setup_minimap();
+    GLint stream_minimap_vertices(const GLfloat* vertices, GLsizei num_vertices);
+    void update_minimap_texture();
     void draw_minimap();
     void overlay_pass();
 };
 
 #define RENDERER Renderer::get_singleton()
+#define GL_STATE RENDERER.get_gl_state()
 
 #endif //DSPROJECT_RENDERER_H
 
@@ -9,6 +9,8 @@
 #include <glad/glad.h>
 #include <memory>
 #include <map>
+#include <string>
+#include <vector>
 
 class ShaderProgram {
 public:
@@ -26,7 +28,7 @@ public:
     static const InternString MAT_ROUGHNESS;
     static const InternString MAT_METALLIC;
 
-    static const InternString GBUFFER_POSITION;
+    static const InternString GBUFFER_DEPTH;
     static const InternString GBUFFER_NORMAL;
     static const InternString GBUFFER_ALBEDO_SPEC;
 
@@ -38,12 +40,17 @@ public:
         Binding(int first = -1, int second = -1) : first(first), second(second) { }
     };
 
-    ShaderProgram(const char * vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
+    /* defines are inserted after the #version line of every stage to specialize the program */
+    ShaderProgram(const char * vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+                  const std::vector<std::string>& defines = std::vector<std::string>());
     GLuint get_program() const { return program; }
 
     void bind();
     void unbind();
 
+    /* attach the uniform block to a binding point if the program uses it */
+    void bind_uniform_block(const char* name, GLuint binding);
+
     void uniform(UniformID id, float v0, float v1, float v2 = 0.0f, float v3 = 0.0f);
     void uniform(UniformID id, int i0);
     void uniform(UniformID id, float f0);
@@ -53,6 +60,8 @@ private:
     GLuint program;
     std::map<UniformID, std::pair<int, GLenum> > uniforms;
 
+    static std::string add_defines(const std::string& code, const std::vector<std::string>& defines);
+
     Binding get_uniform_binding(UniformID id);
     void uniform(const Binding& b, float v0, float v1, float v2, float v3);
     void uniform(const Binding& b, int i0);
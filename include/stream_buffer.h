@@ -0,0 +1,53 @@
+#ifndef DSPROJECT_STREAM_BUFFER_H
+#define DSPROJECT_STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+/* ring of NUM_REGIONS per-frame regions in one vertex buffer for geometry written every frame
+ *
+ * each frame writes into its own region and fences it at the end of the frame, so writing never
+ * waits for draws of the previous frames. the buffer is mapped persistently when
+ * ARB_buffer_storage is available, otherwise each write maps its range unsynchronized and a region
+ * still in use by the GPU is replaced by orphaning the buffer. VAOs point at the buffer with a
+ * zero offset and draw from the returned offsets, they only need to be pointed at it again when
+ * get_generation() changes, which happens whenever the storage is reallocated to grow. the name
+ * alone does not tell, a deleted name may be handed out again for the new storage. */
+class StreamBuffer {
+public:
+    static const int NUM_REGIONS = 3;
+
+    StreamBuffer(GLsizeiptr region_size);
+
+    void setup();
+
+    void begin_frame();
+    void end_frame();
+
+    /* copy the data into the region of this frame, the returned byte offset is a multiple of
+     * stride so that it can be used as the first vertex. draw from it before the next write,
+     * a write that does not fit into the rest of the region starts the region over, a write
+     * larger than the region grows the buffer and leaves the earlier ones in the old storage */
+    GLintptr write(const void* data, GLsizeiptr size, GLsizeiptr stride);
+
+    GLuint get_buffer() const { return buffer; }
+    unsigned int get_generation() const { return generation; }
+
+private:
+    GLuint buffer;
+    unsigned int generation;
+    GLsizeiptr region_size;
+    bool persistent;
+    char* mapping;
+
+    int region;
+    /* bytes of the current region in use */
+    GLsizeiptr head;
+    GLsync fences[NUM_REGIONS];
+
+    void allocate();
+    /* make the region of this frame writable from its start again */
+    void restart_region();
+    void clear_fences();
+};
+
+#endif
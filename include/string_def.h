@@ -10,14 +10,17 @@ const InternString Renderer::BONE_ANIM_SHADER = "bone_animation";
 const InternString Renderer::GEOMETRY_PASS_SHADER = "geometry_pass";
 const InternString Renderer::LIGHTING_PASS_SHADER = "lighting_pass";
 const InternString Renderer::SSAO_SHADER = "SSAO_shader";
-const InternString Renderer::SSAO_BLUR_SHADER = "SSAO_blur_shader";
+const InternString Renderer::SSAO_UPSAMPLE_SHADER = "SSAO_upsample_shader";
 const InternString Renderer::DEPTH_MAP_SHADER = "depth_map_shader";
-const InternString Renderer::HDR_BLEND_SHADER = "HDR_blend_shader";
+const InternString Renderer::COMPOSITE_SHADER = "composite_shader";
 const InternString Renderer::GAUSSIAN_BLUR_SHADER = "gaussian_blur_shader";
+const InternString Renderer::BLOOM_DOWNSAMPLE_SHADER = "bloom_downsample_shader";
+const InternString Renderer::BLOOM_UPSAMPLE_SHADER = "bloom_upsample_shader";
 const InternString Renderer::BILLBOARD_SHADER = "billboard_shader";
 const InternString Renderer::TEXT_OVERLAY_SHADER = "text_overlay_shader";
 const InternString Renderer::MINIMAP_SHADER = "minimap_shader";
 const InternString Renderer::GUI_SHADER = "gui_shader";
+const InternString Renderer::SCREEN_COPY_SHADER = "screen_copy_shader";
 
 const InternString ShaderProgram::MVP = "uMVP";
 const InternString ShaderProgram::VP = "uVP";
@@ -32,7 +35,7 @@ const InternString ShaderProgram::BONE_TRANSFORMS = "uBoneTransforms[0]";
 const InternString ShaderProgram::MAT_ROUGHNESS = "uRoughness";
 const InternString ShaderProgram::MAT_METALLIC = "uMetallic";
 
-const InternString ShaderProgram::GBUFFER_POSITION = "gPosition";
+const InternString ShaderProgram::GBUFFER_DEPTH = "gDepth";
 const InternString ShaderProgram::GBUFFER_NORMAL = "gNormal";
 const InternString ShaderProgram::GBUFFER_ALBEDO_SPEC = "gAlbedoSpec";
 
@@ -4,6 +4,8 @@
 #include "renderable.h"
 
 #include <string>
+#include <vector>
+#include <cstdint>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -11,24 +13,41 @@
 
 class TextOverlay : public Overlay {
 public:
+    /* load the SDF glyph atlas of the font from its disk cache or rasterize printable ASCII */
     static void setup_font(const std::string& name);
+    /* write the glyphs rasterized since the atlas was loaded to the disk cache */
+    static void save_font_cache();
+    static GLuint get_atlas();
+    /* glyphs queued before may be evicted again once the overlay batch is drawn */
+    static void end_batch();
 
     TextOverlay(const std::string& text, float x, float y, glm::vec3 color = {1.0f, 1.0f, 1.0f}, float scale = 1.0f);
+    /* queue the glyph quads of the text into the overlay batch, they are only rebuilt after a
+     * change of the text or an eviction from the glyph atlas */
     virtual void draw(Renderer& renderer) override;
 
-    void set_text(const std::string& text) { this->text = text; }
-    void set_x(float x) { this->x = x; }
-    void set_y(float y) { this->y = y; }
+    void set_text(const std::string& text) { if (text != this->text) { this->text = text; dirty = true; } }
+    void set_x(float x) { if (x != this->x) { this->x = x; dirty = true; } }
+    void set_y(float y) { if (y != this->y) { this->y = y; dirty = true; } }
 
     glm::vec3 get_color() const { return color; }
-    void set_color(glm::vec3 c) { color = c; }
+    void set_color(glm::vec3 c) { if (c != color) { color = c; dirty = true; } }
 
+    /* size of the text on screen, measuring does not add glyphs to the atlas or evict any */
     glm::vec2 size_hint() const;
 
 private:
     std::string text;
     float x, y, scale;
     glm::vec3 color;
+
+    /* cached quads and the atlas cells they sample */
+    std::vector<GLfloat> vertices;
+    std::vector<int> cells;
+    bool dirty;
+    unsigned int generation;
+
+    void build_vertices();
 };
 
 #endif
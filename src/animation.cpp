@@ -38,34 +38,22 @@ void AnimationModel::stop_animation()
     animation_time_sec = 0;
 }
 
-GLfloat identity_transforms[4 * 4 * ShaderProgram::MAX_BONE_TRANSFORMS];
-
 void AnimationModel::draw(Renderer& renderer)
 {
-    static bool first = true;
-    if (first) {
-        for (int i = 0; i < ShaderProgram::MAX_BONE_TRANSFORMS; i++) {
-            memcpy(identity_transforms + 16 * i, glm::value_ptr(glm::mat4()), 4 * 4 * sizeof(GLfloat));
-        }
-    }
-
     vector<Mesh>& meshes = model->get_meshes();
 
     for(GLuint i = 0; i < meshes.size(); i++){
         Mesh& mesh = meshes[i];
 
+        vector<glm::mat4> transforms;
         if (current_animation) {
-            vector<glm::mat4> transforms;
             mesh.update_bone_transform(current_animation, animation_time_sec, transforms);
+        }
 
-            GLfloat* matrices = new GLfloat[4 * 4 * transforms.size()];
-            for (int i = 0; i < transforms.size(); i++) {
-                memcpy(matrices + 16 * i, glm::value_ptr(transforms[i]), 4 * 4 * sizeof(GLfloat));
-            }
-            RENDERER.uniform(ShaderProgram::BONE_TRANSFORMS, transforms.size(), false, matrices);
-            delete[] matrices;
+        if (!transforms.empty()) {
+            renderer.set_bone_transforms(transforms.size(), glm::value_ptr(transforms[0]));
         } else {
-            RENDERER.uniform(ShaderProgram::BONE_TRANSFORMS, ShaderProgram::MAX_BONE_TRANSFORMS, false, identity_transforms);
+            renderer.use_identity_bones();
         }
 
         meshes[i].draw(renderer);
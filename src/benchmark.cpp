@@ -0,0 +1,141 @@
+#include "benchmark.h"
+#include "config.h"
+#include "renderer.h"
+#include "animation_manager.h"
+#include "character_manager.h"
+#include "particle_system.h"
+#include "log_manager.h"
+#include "exception.h"
+#include "map.h"
+
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+#include <GLFW/glfw3.h>
+
+const float RenderBenchmark::FRAME_TIME = 1.0f / 60.0f;
+const float RenderBenchmark::EYE_HEIGHT = 1.0f;
+
+RenderBenchmark::RenderBenchmark(int frames, int warmup_frames, const std::string& output) :
+    frames(frames), warmup_frames(warmup_frames), output(output)
+{
+}
+
+void RenderBenchmark::build_path()
+{
+    path.clear();
+    path_distance.clear();
+
+    for (auto& room : g_map->get_rooms()) {
+        glm::vec3 center((room.x + room.width * 0.5f) * Map::TILE_SIZE, EYE_HEIGHT, (room.y + room.height * 0.5f) * Map::TILE_SIZE);
+        path_distance.push_back(path.empty() ? 0.0f : path_distance.back() + glm::distance(path.back(), center));
+        path.push_back(center);
+    }
+
+    if (path.size() < 2) {
+        THROW_EXCEPT(E_INVALID_STATE, "RenderBenchmark::build_path()", "benchmark map has less than two rooms");
+    }
+}
+
+glm::vec3 RenderBenchmark::sample_path(float t, glm::vec3& direction) const
+{
+    float distance = t * path_distance.back();
+    size_t i = std::upper_bound(path_distance.begin(), path_distance.end(), distance) - path_distance.begin();
+    i = std::min(std::max(i, (size_t)1), path.size() - 1);
+
+    float length = path_distance[i] - path_distance[i - 1];
+    float s = length > 0.0f ? (distance - path_distance[i - 1]) / length : 0.0f;
+
+    direction = path[i] - path[i - 1];
+    return path[i - 1] + direction * std::min(s, 1.0f);
+}
+
+void RenderBenchmark::run()
+{
+    LOG.info("Benchmark: %d frames (%d warmup) at %dx%d", frames, warmup_frames, g_screen_width, g_screen_height);
+
+    build_path();
+
+    GPUProfiler& profiler = RENDERER.get_gpu_profiler();
+    profiler.set_keep_history(true);
+
+    PRenderable map(g_map);
+    Camera camera(path[0].x, path[0].y, path[0].z, 0.0f, 1.0f, 0.0f);
+
+    std::vector<double> frame_times;
+    int total = warmup_frames + frames;
+    for (int frame = 0; frame < total; frame++) {
+        /* timer results arrive a couple of frames late, the tail of the warmup is negligible */
+        if (frame == warmup_frames) profiler.clear_history();
+
+        double start = glfwGetTime();
+        glfwPollEvents();
+
+        ANIMATION_MANAGER.update(FRAME_TIME);
+        PARTICLE_SYSTEM.update(FRAME_TIME);
+
+        glm::vec3 direction;
+        glm::vec3 position = sample_path(total > 1 ? frame / (float)(total - 1) : 0.0f, direction);
+        camera.set_position(position);
+        camera.set_yaw(glm::degrees(atan2(direction.z, direction.x)));
+
+        RENDERER.begin_frame();
+        RENDERER.update_camera(camera);
+        RENDERER.enqueue_renderable(map);
+        CHARACTER_MANAGER.submit(RENDERER);
+        PARTICLE_SYSTEM.submit(RENDERER);
+        RENDERER.end_frame();
+
+        glfwSwapBuffers(g_window);
+        /* wait for the GPU so that the frame time covers the work of this frame only */
+        glFinish();
+
+        if (frame >= warmup_frames) frame_times.push_back((glfwGetTime() - start) * 1000.0);
+    }
+
+    write_results(frame_times);
+}
+
+double RenderBenchmark::percentile(std::vector<double> samples, double p)
+{
+    if (samples.empty()) return 0.0;
+
+    /* nearest rank */
+    std::sort(samples.begin(), samples.end());
+    size_t rank = (size_t)ceil(p / 100.0 * samples.size());
+    return samples[std::min(std::max(rank, (size_t)1), samples.size()) - 1];
+}
+
+void RenderBenchmark::write_results(const std::vector<double>& frame_times) const
+{
+    std::ofstream file(output.c_str());
+    if (!file) {
+        THROW_EXCEPT(E_FILE_NOT_FOUND, "RenderBenchmark::write_results()", "cannot write benchmark results to " + output);
+    }
+
+    auto write_percentiles = [&file](const std::vector<double>& samples) {
+        file << "{\"p50\": " << percentile(samples, 50.0) << ", \"p95\": " << percentile(samples, 95.0)
+             << ", \"p99\": " << percentile(samples, 99.0) << ", \"samples\": " << samples.size() << "}";
+    };
+
+    file << "{\n";
+    file << "  \"seed\": " << MAP_SEED << ",\n";
+    file << "  \"frames\": " << frames << ",\n";
+    file << "  \"resolution\": [" << g_screen_width << ", " << g_screen_height << "],\n";
+    file << "  \"renderer\": \"" << (const char*)glGetString(GL_RENDERER) << "\",\n";
+    file << "  \"frame_ms\": ";
+    write_percentiles(frame_times);
+    file << ",\n  \"passes_ms\": {\n";
+
+    const GPUProfiler& profiler = RENDERER.get_gpu_profiler();
+    for (size_t i = 0; i < profiler.get_num_timers(); i++) {
+        const GPUProfiler::Timer& timer = profiler.get_timer(i);
+        file << "    \"" << timer.name << "\": ";
+        write_percentiles(timer.history);
+        file << (i + 1 < profiler.get_num_timers() ? ",\n" : "\n");
+    }
+    file << "  }\n}\n";
+
+    LOG.info("Benchmark: p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, results written to %s",
+             percentile(frame_times, 50.0), percentile(frame_times, 95.0), percentile(frame_times, 99.0), output.c_str());
+}
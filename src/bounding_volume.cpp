@@ -0,0 +1,115 @@
+#include "bounding_volume.h"
+
+#include <cmath>
+#include <limits>
+
+AABB::AABB() : min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max())
+{
+}
+
+AABB::AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max)
+{
+}
+
+void AABB::expand(const glm::vec3& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void AABB::expand(const AABB& box)
+{
+    if (box.is_empty()) return;
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+}
+
+void AABB::scale(float factor)
+{
+    if (is_empty()) return;
+    glm::vec3 center = get_center();
+    glm::vec3 extents = get_extents() * factor;
+    min = center - extents;
+    max = center + extents;
+}
+
+AABB AABB::transform(const glm::mat4& m) const
+{
+    if (is_empty()) return *this;
+
+    glm::vec3 center(m * glm::vec4(get_center(), 1.0f));
+    glm::vec3 extents = get_extents();
+
+    /* project the extents onto each world axis */
+    glm::vec3 world_extents;
+    for (int i = 0; i < 3; i++) {
+        world_extents[i] = fabs(m[0][i]) * extents.x + fabs(m[1][i]) * extents.y + fabs(m[2][i]) * extents.z;
+    }
+
+    return AABB(center - world_extents, center + world_extents);
+}
+
+bool AABB::intersects(const glm::vec3& center, float radius) const
+{
+    if (is_empty()) return false;
+
+    glm::vec3 closest = glm::min(glm::max(center, min), max);
+    return glm::distance(closest, center) <= radius;
+}
+
+Frustum::Frustum()
+{
+    for (int i = 0; i < 6; i++) {
+        planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+Frustum::Frustum(const glm::mat4& vp)
+{
+    /* rows of the matrix, glm is column major */
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(vp[0][i], vp[1][i], vp[2][i], vp[3][i]);
+    }
+
+    planes[0] = rows[3] + rows[0];  /* left */
+    planes[1] = rows[3] - rows[0];  /* right */
+    planes[2] = rows[3] + rows[1];  /* bottom */
+    planes[3] = rows[3] - rows[1];  /* top */
+    planes[4] = rows[3] + rows[2];  /* near */
+    planes[5] = rows[3] - rows[2];  /* far */
+
+    for (int i = 0; i < 6; i++) {
+        planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+    }
+}
+
+Frustum::Frustum(const glm::vec4& plane)
+{
+    for (int i = 0; i < 6; i++) {
+        planes[i] = plane;
+    }
+}
+
+bool Frustum::intersects(const AABB& box) const
+{
+    if (box.is_empty()) return false;
+
+    glm::vec3 center = box.get_center();
+    glm::vec3 extents = box.get_extents();
+
+    for (int i = 0; i < 6; i++) {
+        glm::vec3 normal(planes[i]);
+        float radius = glm::dot(extents, glm::abs(normal));
+        if (glm::dot(normal, center) + planes[i].w < -radius) return false;
+    }
+    return true;
+}
+
+bool Frustum::intersects(const glm::vec3& center, float radius) const
+{
+    for (int i = 0; i < 6; i++) {
+        if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius) return false;
+    }
+    return true;
+}
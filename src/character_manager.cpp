@@ -11,10 +11,16 @@ CharacterManager::CharacterManager()
 void CharacterManager::submit(Renderer& renderer) const
 {
     for (auto& p : chars) {
-        renderer.enqueue_renderable(p);
+        AABB bound = p->get_bound();
+        if (renderer.is_visible(bound) || renderer.casts_shadow(bound)) {
+            renderer.enqueue_renderable(p);
+        }
     }
 	for (auto& p : items) {
-		renderer.enqueue_renderable(p);
+		AABB bound = p->get_bound();
+		if (renderer.is_visible(bound) || renderer.casts_shadow(bound)) {
+			renderer.enqueue_renderable(p);
+		}
 	}
 }
 
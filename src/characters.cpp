@@ -5,6 +5,7 @@
 #include "map.h"
 #include "character_manager.h"
 #include "config.h"
+#include "profiler.h"
 
 #include <cmath>
 #include <queue>
@@ -21,14 +22,25 @@ void BaseCharacter::init_model()
 void BaseCharacter::draw(Renderer& renderer)
 {
 	renderer.push_matrix();
+	renderer.transform(get_model_matrix());
+	model->draw(renderer);
+	renderer.pop_matrix();
+}
+
+glm::mat4 BaseCharacter::get_model_matrix() const
+{
 	auto pos = get_position();
 	auto rot = get_rotation();
 	auto axis = glm::axis(rot);
-	renderer.translate(pos[0], pos[1], pos[2]);
-	renderer.rotate(glm::angle(rot), axis[0], axis[1], axis[2]);
-	intrinsic_transform(renderer);
-	model->draw(renderer);
-	renderer.pop_matrix();
+	glm::mat4 transform = glm::translate(glm::mat4(), pos);
+	transform = glm::rotate(transform, glm::angle(rot), axis);
+	return transform * intrinsic_transform();
+}
+
+AABB BaseCharacter::get_bound() const
+{
+	if (!model) return AABB();
+	return model->get_bound().transform(get_model_matrix());
 }
 
 void BaseCharacter::set_animation(InternString name)
@@ -179,14 +191,18 @@ AnimationModel* SkeletonCharacter::load_model() const
     return new AnimationModel(_prepare_model());
 }
 
-void SkeletonCharacter::intrinsic_transform(Renderer& renderer) 
+glm::mat4 SkeletonCharacter::intrinsic_transform() const
 {
-	renderer.translate(0.0f, -1.25f, 0.0f);
-	renderer.scale(0.02f, 0.02f, 0.02f);
+	glm::mat4 transform;
+	transform = glm::translate(transform, glm::vec3(0.0f, -1.25f, 0.0f));
+	transform = glm::scale(transform, glm::vec3(0.02f, 0.02f, 0.02f));
+	return transform;
 }
 
 void SkeletonCharacter::update(float dt)
 {
+    PROFILE_ZONE("SkeletonCharacter::update");
+
 	const float ATTACK_DIST_THRESHOLD = 1.0f;
 	const float TURN_THRESHOLD = glm::radians(10.f);
 
@@ -287,11 +303,13 @@ AnimationModel* TrapItem::load_model() const
 	return new AnimationModel(_prepare_model());
 }
 
-void TrapItem::intrinsic_transform(Renderer& renderer)
+glm::mat4 TrapItem::intrinsic_transform() const
 {
-	renderer.translate(0.5f * Map::TILE_SIZE, 0.0f, 0.5f * Map::TILE_SIZE);
-	renderer.rotate(glm::radians(-90.0f), 1.0f, 0.0f, 0.0f);
-	renderer.scale(0.45f, 0.45f, 0.45f);
+	glm::mat4 transform;
+	transform = glm::translate(transform, glm::vec3(0.5f * Map::TILE_SIZE, 0.0f, 0.5f * Map::TILE_SIZE));
+	transform = glm::rotate(transform, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	transform = glm::scale(transform, glm::vec3(0.45f, 0.45f, 0.45f));
+	return transform;
 }
 
 void TrapItem::update(float dt)
@@ -323,10 +341,12 @@ AnimationModel* ChestTrapItem::load_model() const
 	return new AnimationModel(_prepare_model());
 }
 
-void ChestTrapItem::intrinsic_transform(Renderer& renderer)
+glm::mat4 ChestTrapItem::intrinsic_transform() const
 {
-	renderer.translate(-1.3f, -0.5f, 0.0f);
-	renderer.scale(0.04f, 0.04f, 0.04f);
+	glm::mat4 transform;
+	transform = glm::translate(transform, glm::vec3(-1.3f, -0.5f, 0.0f));
+	transform = glm::scale(transform, glm::vec3(0.04f, 0.04f, 0.04f));
+	return transform;
 }
 
 btRigidBody* ChestTrapItem::setup_rigid_body(const btTransform& trans)
@@ -372,10 +392,12 @@ AnimationModel* TorchItem::load_model() const
 	return new AnimationModel(_prepare_model());
 }
 
-void TorchItem::intrinsic_transform(Renderer& renderer)
+glm::mat4 TorchItem::intrinsic_transform() const
 {
-	renderer.translate(0.0f, -0.5f, 0.0f);
-	renderer.scale(0.18f, 0.18f, 0.18f);
+	glm::mat4 transform;
+	transform = glm::translate(transform, glm::vec3(0.0f, -0.5f, 0.0f));
+	transform = glm::scale(transform, glm::vec3(0.18f, 0.18f, 0.18f));
+	return transform;
 }
 
 btRigidBody* TorchItem::setup_rigid_body(const btTransform& trans)
@@ -408,11 +430,13 @@ AnimationModel* BarrelItem::load_model() const
 	return new AnimationModel(_prepare_model());
 }
 
-void BarrelItem::intrinsic_transform(Renderer& renderer)
+glm::mat4 BarrelItem::intrinsic_transform() const
 {
-	renderer.translate(0.0f, -0.5f, 0.0f);
-	renderer.rotate(glm::radians(-90.0f), 1.0f, 0.0f, 0.0f);
-	renderer.scale(0.006f, 0.006f, 0.006f);
+	glm::mat4 transform;
+	transform = glm::translate(transform, glm::vec3(0.0f, -0.5f, 0.0f));
+	transform = glm::rotate(transform, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	transform = glm::scale(transform, glm::vec3(0.006f, 0.006f, 0.006f));
+	return transform;
 }
 
 btRigidBody* BarrelItem::setup_rigid_body(const btTransform& trans)
@@ -445,10 +469,12 @@ AnimationModel* ChestKeyItem::load_model() const
 	return new AnimationModel(_prepare_model());
 }
 
-void ChestKeyItem::intrinsic_transform(Renderer& renderer)
+glm::mat4 ChestKeyItem::intrinsic_transform() const
 {
-	renderer.translate(-1.3f, -0.5f, 0.0f);
-	renderer.scale(0.04f, 0.04f, 0.04f);
+	glm::mat4 transform;
+	transform = glm::translate(transform, glm::vec3(-1.3f, -0.5f, 0.0f));
+	transform = glm::scale(transform, glm::vec3(0.04f, 0.04f, 0.04f));
+	return transform;
 }
 
 btRigidBody* ChestKeyItem::setup_rigid_body(const btTransform& trans)
@@ -16,6 +16,18 @@ int g_screen_width;
 int g_screen_height;
 bool g_fullscreen;
 int g_MSAA;
+int g_shadow_atlas_size;
+int g_shadow_lights;
+Renderer::ShadowTechnique g_shadow_technique;
+int g_ssao_scale;
+int g_ssao_samples;
+int g_bloom_mips;
+int g_bloom_iterations;
+bool g_bloom;
+bool g_fxaa;
+bool g_vignette;
+bool g_gpu_timers;
+std::string g_gpu_timer_dump;
 std::string g_font;
 
 ConfigFile::ConfigFile() : root(nullptr)
@@ -90,6 +90,7 @@ WidgetController::WidgetController(const std::string& bg)
 {
     background.reset(new GUILabel(0.f, g_screen_height, g_screen_width, g_screen_height,  "", MaterialTexture::create_texture(bg)));
     layout_y = 0.9 * g_screen_height;
+    view_dirty = true;
 }
 
 void WidgetController::add_widget(PGUIWidget widget)
@@ -120,10 +121,17 @@ void WidgetController::handle_key(int key, int scancode, int action, int mode)
 void WidgetController::handle_mouse(double xpos, double ypos)
 {
     for (auto&& p: widgets) {
-        p->handle_mouse(xpos, g_screen_height - ypos);
+        if (p->handle_mouse(xpos, g_screen_height - ypos)) view_dirty = true;
     }
 }
 
+bool WidgetController::poll_redraw()
+{
+    bool redraw = view_dirty;
+    view_dirty = false;
+    return redraw;
+}
+
 MainMenuController::MainMenuController() : WidgetController("start2.bmp")
 {
     PGUIWidget title(new GUILabel("Weeaboo's", 2.0f, {0.0f, 0.0f, 0.0f}));
@@ -135,7 +143,7 @@ MainMenuController::MainMenuController() : WidgetController("start2.bmp")
     btn_start->set_enabled(true);
     btn_start->set_on_click_listener([](GUIWidget*){ Controller::switch_controller("game"); });
     btn_exit->set_enabled(true);
-    btn_exit->set_on_click_listener([](GUIWidget*){ ::exit(0); });
+    btn_exit->set_on_click_listener([](GUIWidget*){ glfwSetWindowShouldClose(g_window, GL_TRUE); });
 
     add_widget(title);
     add_widget(title2);
@@ -154,7 +162,7 @@ InGameMenuController::InGameMenuController(): WidgetController("start.bmp")
     btn_resume->set_enabled(true);
     btn_resume->set_on_click_listener([](GUIWidget*){ Controller::switch_controller("game"); });
     btn_exit->set_enabled(true);
-    btn_exit->set_on_click_listener([](GUIWidget*){ ::exit(0); });
+    btn_exit->set_on_click_listener([](GUIWidget*){ glfwSetWindowShouldClose(g_window, GL_TRUE); });
 
     add_widget(title);
     add_widget(split);
@@ -170,7 +178,7 @@ EndGameController::EndGameController(): WidgetController("start.bmp")
     PGUIWidget btn_exit(new GUILabel("Exit", 1.2f, {0.0f, 0.0f, 0.0f}));
 
     btn_exit->set_enabled(true);
-    btn_exit->set_on_click_listener([](GUIWidget*){ ::exit(0); });
+    btn_exit->set_on_click_listener([](GUIWidget*){ glfwSetWindowShouldClose(g_window, GL_TRUE); });
 
     add_widget(title);
     add_widget(score);
@@ -180,6 +188,8 @@ EndGameController::EndGameController(): WidgetController("start.bmp")
 
 void EndGameController::enter()
 {
+    WidgetController::enter();
+
     if (CHARACTER_MANAGER.main_char().get_hp() <= 0.0f) {
         title->set_text("YOU DIED");
         title->set_color({1.0f, 0.0f, 0.0f});
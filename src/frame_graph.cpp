@@ -0,0 +1,294 @@
+#include "frame_graph.h"
+#include "gl_state.h"
+#include "gpu_profiler.h"
+#include "exception.h"
+
+#include <algorithm>
+
+FrameGraph::Resource FrameGraph::PassBuilder::create(const std::string& name, const TextureDesc& desc)
+{
+    ResourceNode node;
+    node.name = name;
+    node.desc = desc;
+    node.texture = 0;
+    node.imported = false;
+    node.ref_count = 0;
+    node.first_use = node.last_use = -1;
+    graph.resources.push_back(node);
+
+    return write(graph.resources.size() - 1);
+}
+
+FrameGraph::Resource FrameGraph::PassBuilder::read(Resource resource)
+{
+    graph.passes[pass].reads.push_back(resource);
+    return resource;
+}
+
+FrameGraph::Resource FrameGraph::PassBuilder::write(Resource resource)
+{
+    graph.passes[pass].writes.push_back(resource);
+    graph.resources[resource].writers.push_back(pass);
+    return resource;
+}
+
+void FrameGraph::PassBuilder::side_effect()
+{
+    graph.passes[pass].side_effect = true;
+}
+
+FrameGraph::FrameGraph(GLState& gl_state) : gl_state(gl_state), num_culled(0)
+{
+}
+
+void FrameGraph::reset(int back_buffer_width, int back_buffer_height)
+{
+    resources.clear();
+    passes.clear();
+    num_culled = 0;
+    back_buffer_size = glm::ivec2(back_buffer_width, back_buffer_height);
+}
+
+FrameGraph::Resource FrameGraph::import_texture(const std::string& name, GLuint texture, const TextureDesc& desc)
+{
+    ResourceNode node;
+    node.name = name;
+    node.desc = desc;
+    node.texture = texture;
+    node.imported = true;
+    node.ref_count = 0;
+    node.first_use = node.last_use = -1;
+    resources.push_back(node);
+
+    return resources.size() - 1;
+}
+
+void FrameGraph::add_pass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute)
+{
+    PassNode node;
+    node.name = name;
+    node.side_effect = false;
+    node.ref_count = 0;
+    node.culled = false;
+    node.fbo = 0;
+    node.execute = execute;
+    passes.push_back(node);
+
+    PassBuilder builder(*this, passes.size() - 1);
+    setup(builder);
+}
+
+void FrameGraph::compile()
+{
+    cull_passes();
+    compute_lifetimes();
+    allocate_textures();
+
+    for (auto& pass : passes) {
+        if (!pass.culled) pass.fbo = get_framebuffer(pass);
+    }
+
+    trim_pool();
+}
+
+void FrameGraph::execute(GPUProfiler* profiler)
+{
+    for (auto& pass : passes) {
+        if (pass.culled) continue;
+
+        glm::ivec2 size = back_buffer_size;
+        if (!pass.writes.empty()) {
+            const TextureDesc& desc = resources[pass.writes[0]].desc;
+            size = glm::ivec2(desc.width, desc.height);
+        }
+
+        gl_state.bind_framebuffer(GL_FRAMEBUFFER, pass.fbo);
+        glViewport(0, 0, size.x, size.y);
+        if (profiler) profiler->begin(pass.name);
+        pass.execute(*this);
+        if (profiler) profiler->end();
+    }
+
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, back_buffer_size.x, back_buffer_size.y);
+}
+
+GLuint FrameGraph::get_texture(Resource resource) const
+{
+    return resources[resource].texture;
+}
+
+bool FrameGraph::is_depth_format(GLenum format)
+{
+    return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+}
+
+void FrameGraph::cull_passes()
+{
+    for (auto& pass : passes) {
+        pass.ref_count = pass.writes.size();
+        for (auto resource : pass.reads) {
+            resources[resource].ref_count++;
+        }
+    }
+
+    /* resources nobody reads, their writers lose a reference */
+    std::vector<Resource> unused;
+    for (size_t i = 0; i < resources.size(); i++) {
+        if (resources[i].ref_count == 0) unused.push_back(i);
+    }
+
+    while (!unused.empty()) {
+        Resource resource = unused.back();
+        unused.pop_back();
+
+        for (auto writer : resources[resource].writers) {
+            PassNode& pass = passes[writer];
+            if (pass.culled || pass.side_effect) continue;
+            if (--pass.ref_count > 0) continue;
+
+            pass.culled = true;
+            num_culled++;
+            for (auto input : pass.reads) {
+                if (--resources[input].ref_count == 0) unused.push_back(input);
+            }
+        }
+    }
+}
+
+void FrameGraph::compute_lifetimes()
+{
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (passes[i].culled) continue;
+
+        auto use = [this, i](Resource resource) {
+            ResourceNode& node = resources[resource];
+            if (node.first_use == -1) node.first_use = i;
+            node.last_use = i;
+        };
+
+        for (auto resource : passes[i].reads) use(resource);
+        for (auto resource : passes[i].writes) use(resource);
+    }
+}
+
+void FrameGraph::allocate_textures()
+{
+    for (auto& texture : pool) {
+        texture.used = texture.busy = false;
+    }
+
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (passes[i].culled) continue;
+
+        for (auto& node : resources) {
+            if (!node.imported && node.first_use == (int)i) node.texture = acquire_texture(node.desc);
+        }
+
+        /* textures whose last user is this pass can be aliased by the following passes */
+        for (auto& node : resources) {
+            if (!node.imported && node.last_use == (int)i) release_texture(node.texture);
+        }
+    }
+}
+
+GLuint FrameGraph::acquire_texture(const TextureDesc& desc)
+{
+    for (auto& texture : pool) {
+        if (!texture.busy && texture.desc == desc) {
+            texture.used = texture.busy = true;
+            return texture.texture;
+        }
+    }
+
+    PooledTexture texture;
+    texture.desc = desc;
+    texture.used = texture.busy = true;
+
+    bool depth = is_depth_format(desc.format);
+    glGenTextures(1, &texture.texture);
+    gl_state.bind_texture(GL_TEXTURE_2D, texture.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0,
+                 depth ? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl_state.bind_texture(GL_TEXTURE_2D, 0);
+
+    pool.push_back(texture);
+    return texture.texture;
+}
+
+void FrameGraph::release_texture(GLuint texture)
+{
+    for (auto& pooled : pool) {
+        if (pooled.texture == texture) pooled.busy = false;
+    }
+}
+
+GLuint FrameGraph::get_framebuffer(const PassNode& pass)
+{
+    if (pass.writes.empty()) return 0;
+
+    std::vector<GLuint> attachments;
+    for (auto resource : pass.writes) {
+        attachments.push_back(resources[resource].texture);
+    }
+
+    auto it = fbo_cache.find(attachments);
+    if (it != fbo_cache.end()) return it->second;
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, fbo);
+
+    std::vector<GLenum> draw_buffers;
+    for (auto resource : pass.writes) {
+        const ResourceNode& node = resources[resource];
+        if (is_depth_format(node.desc.format)) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, node.texture, 0);
+        } else {
+            GLenum attachment = GL_COLOR_ATTACHMENT0 + draw_buffers.size();
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, node.texture, 0);
+            draw_buffers.push_back(attachment);
+        }
+    }
+
+    if (draw_buffers.empty()) glDrawBuffer(GL_NONE);
+    else glDrawBuffers(draw_buffers.size(), &draw_buffers[0]);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        THROW_EXCEPT(E_RENDER_ENGINE_ERROR, "FrameGraph::get_framebuffer()", "cannot setup framebuffer of pass " + pass.name);
+    }
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+
+    fbo_cache[attachments] = fbo;
+    return fbo;
+}
+
+void FrameGraph::trim_pool()
+{
+    /* textures not needed this frame (e.g. after a resize) are freed with their framebuffers */
+    for (auto it = pool.begin(); it != pool.end();) {
+        if (it->used) {
+            ++it;
+            continue;
+        }
+
+        for (auto fbo = fbo_cache.begin(); fbo != fbo_cache.end();) {
+            const std::vector<GLuint>& attachments = fbo->first;
+            if (std::find(attachments.begin(), attachments.end(), it->texture) != attachments.end()) {
+                gl_state.forget_framebuffer(fbo->second);
+                glDeleteFramebuffers(1, &fbo->second);
+                fbo = fbo_cache.erase(fbo);
+            } else {
+                ++fbo;
+            }
+        }
+
+        gl_state.forget_texture(it->texture);
+        glDeleteTextures(1, &it->texture);
+        it = pool.erase(it);
+    }
+}
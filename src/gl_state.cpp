@@ -0,0 +1,189 @@
+#include "gl_state.h"
+
+/* never a valid name, the binding is not known */
+static const GLuint UNKNOWN = ~0u;
+
+GLState::GLState() : issued(0), filtered(0), last_issued(0), last_filtered(0)
+{
+    invalidate();
+}
+
+void GLState::invalidate()
+{
+    program = UNKNOWN;
+    vao = UNKNOWN;
+    draw_fbo = UNKNOWN;
+    read_fbo = UNKNOWN;
+    active_unit = UNKNOWN;
+    for (int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+        for (int j = 0; j < NUM_TEXTURE_TARGETS; j++) textures[i][j] = UNKNOWN;
+    }
+    for (int i = 0; i < NUM_CAPS; i++) caps[i] = CAP_UNKNOWN;
+    blend_src = blend_dst = UNKNOWN;
+}
+
+void GLState::begin_frame()
+{
+    last_issued = issued;
+    last_filtered = filtered;
+    issued = filtered = 0;
+}
+
+bool GLState::update(GLuint& current, GLuint value)
+{
+    if (current == value) {
+        filtered++;
+        return false;
+    }
+
+    current = value;
+    issued++;
+    return true;
+}
+
+void GLState::use_program(GLuint program)
+{
+    if (update(this->program, program)) glUseProgram(program);
+}
+
+void GLState::bind_vertex_array(GLuint vao)
+{
+    if (update(this->vao, vao)) glBindVertexArray(vao);
+}
+
+void GLState::bind_framebuffer(GLenum target, GLuint fbo)
+{
+    if (target == GL_FRAMEBUFFER) {
+        if (draw_fbo == fbo && read_fbo == fbo) {
+            filtered++;
+            return;
+        }
+        draw_fbo = read_fbo = fbo;
+        issued++;
+        glBindFramebuffer(target, fbo);
+    } else if (target == GL_DRAW_FRAMEBUFFER) {
+        if (update(draw_fbo, fbo)) glBindFramebuffer(target, fbo);
+    } else if (target == GL_READ_FRAMEBUFFER) {
+        if (update(read_fbo, fbo)) glBindFramebuffer(target, fbo);
+    }
+}
+
+GLuint GLState::get_draw_framebuffer()
+{
+    if (draw_fbo == UNKNOWN) {
+        GLint fbo;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+        draw_fbo = fbo;
+    }
+    return draw_fbo;
+}
+
+void GLState::active_texture(GLenum unit)
+{
+    /* an invalid unit fails in GL and leaves the active unit alone */
+    if (unit < GL_TEXTURE0 || unit >= GL_TEXTURE0 + MAX_TEXTURE_UNITS) {
+        issued++;
+        glActiveTexture(unit);
+        return;
+    }
+
+    if (update(active_unit, unit)) glActiveTexture(unit);
+}
+
+void GLState::bind_texture(GLenum target, GLuint texture)
+{
+    int index = get_target_index(target);
+    if (index < 0) {
+        issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (active_unit == UNKNOWN) {
+        /* some unit changed, none of them is known any more */
+        for (int i = 0; i < MAX_TEXTURE_UNITS; i++) textures[i][index] = UNKNOWN;
+        issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+
+    if (update(textures[active_unit - GL_TEXTURE0][index], texture)) glBindTexture(target, texture);
+}
+
+void GLState::enable(GLenum cap)
+{
+    set_cap(cap, true);
+}
+
+void GLState::disable(GLenum cap)
+{
+    set_cap(cap, false);
+}
+
+void GLState::set_cap(GLenum cap, bool enabled)
+{
+    int index = get_cap_index(cap);
+    CapState state = enabled ? CAP_ENABLED : CAP_DISABLED;
+    if (index >= 0) {
+        if (caps[index] == state) {
+            filtered++;
+            return;
+        }
+        caps[index] = state;
+    }
+
+    issued++;
+    if (enabled) glEnable(cap);
+    else glDisable(cap);
+}
+
+void GLState::blend_func(GLenum src, GLenum dst)
+{
+    if (blend_src == src && blend_dst == dst) {
+        filtered++;
+        return;
+    }
+
+    blend_src = src;
+    blend_dst = dst;
+    issued++;
+    glBlendFunc(src, dst);
+}
+
+void GLState::forget_texture(GLuint texture)
+{
+    for (int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+        for (int j = 0; j < NUM_TEXTURE_TARGETS; j++) {
+            if (textures[i][j] == texture) textures[i][j] = 0;
+        }
+    }
+}
+
+void GLState::forget_framebuffer(GLuint fbo)
+{
+    if (draw_fbo == fbo) draw_fbo = 0;
+    if (read_fbo == fbo) read_fbo = 0;
+}
+
+int GLState::get_target_index(GLenum target)
+{
+    switch (target) {
+    case GL_TEXTURE_2D: return TARGET_2D;
+    case GL_TEXTURE_CUBE_MAP: return TARGET_CUBE_MAP;
+    case GL_TEXTURE_BUFFER: return TARGET_BUFFER;
+    case GL_TEXTURE_2D_ARRAY: return TARGET_2D_ARRAY;
+    default: return -1;
+    }
+}
+
+int GLState::get_cap_index(GLenum cap)
+{
+    switch (cap) {
+    case GL_BLEND: return CAP_BLEND;
+    case GL_DEPTH_TEST: return CAP_DEPTH_TEST;
+    case GL_CULL_FACE: return CAP_CULL_FACE;
+    case GL_SCISSOR_TEST: return CAP_SCISSOR_TEST;
+    case GL_CLIP_DISTANCE0: return CAP_CLIP_DISTANCE0;
+    case GL_MULTISAMPLE: return CAP_MULTISAMPLE;
+    default: return -1;
+    }
+}
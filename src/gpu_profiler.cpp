@@ -0,0 +1,173 @@
+#include "gpu_profiler.h"
+#include "log_manager.h"
+
+#include <fstream>
+#include <algorithm>
+
+double GPUProfiler::Timer::get_average() const
+{
+    if (samples.empty()) return 0.0;
+
+    double sum = 0.0;
+    for (auto sample : samples) sum += sample;
+    return sum / samples.size();
+}
+
+double GPUProfiler::Timer::get_min() const
+{
+    if (samples.empty()) return 0.0;
+    return *std::min_element(samples.begin(), samples.end());
+}
+
+double GPUProfiler::Timer::get_max() const
+{
+    if (samples.empty()) return 0.0;
+    return *std::max_element(samples.begin(), samples.end());
+}
+
+double GPUProfiler::Timer::get_last() const
+{
+    if (samples.empty()) return 0.0;
+    return samples[(next + samples.size() - 1) % samples.size()];
+}
+
+GPUProfiler::GPUProfiler() : enabled(false), keep_history(false), frame(0), in_scope(false)
+{
+}
+
+void GPUProfiler::clear_history()
+{
+    for (auto& timer : timers) timer.history.clear();
+}
+
+void GPUProfiler::begin_frame()
+{
+    if (!enabled) return;
+
+    frame++;
+    /* the slot was last used QUERY_LATENCY frames ago, read it back before reusing its queries */
+    int slot = frame % QUERY_LATENCY;
+    collect(slot);
+    frame_queries[slot].clear();
+}
+
+void GPUProfiler::begin(const std::string& name)
+{
+    if (!enabled) return;
+    if (in_scope) {
+        LOG.warn("GPU_PROFILER::scope %s begins inside another scope", name.c_str());
+        return;
+    }
+
+    int slot = frame % QUERY_LATENCY;
+    std::vector<GLuint>& pool = query_pool[slot];
+    std::vector<Query>& queries = frame_queries[slot];
+
+    if (queries.size() == pool.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        pool.push_back(query);
+    }
+
+    Query query;
+    query.timer = get_timer_index(name);
+    query.query = pool[queries.size()];
+    queries.push_back(query);
+
+    glBeginQuery(GL_TIME_ELAPSED, query.query);
+    in_scope = true;
+}
+
+void GPUProfiler::end()
+{
+    if (!enabled || !in_scope) return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    in_scope = false;
+}
+
+double GPUProfiler::get_frame_time() const
+{
+    double total = 0.0;
+    for (auto& timer : timers) total += timer.get_average();
+    return total;
+}
+
+int GPUProfiler::get_timer_index(const std::string& name)
+{
+    auto it = timer_index.find(name);
+    if (it != timer_index.end()) return it->second;
+
+    Timer timer;
+    timer.name = name;
+    timer.next = 0;
+    timers.push_back(timer);
+
+    int index = timers.size() - 1;
+    timer_index[name] = index;
+    return index;
+}
+
+void GPUProfiler::collect(int slot)
+{
+    std::vector<Query>& queries = frame_queries[slot];
+    if (queries.empty()) return;
+
+    /* queries complete in order, if the last one is not ready the frame is dropped instead of waiting */
+    GLint available = 0;
+    glGetQueryObjectiv(queries.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return;
+
+    std::vector<double> totals(timers.size(), -1.0);
+    for (auto& query : queries) {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query.query, GL_QUERY_RESULT, &elapsed);
+
+        double& total = totals[query.timer];
+        if (total < 0.0) total = 0.0;
+        total += elapsed / 1.0e6;
+    }
+
+    for (size_t i = 0; i < timers.size(); i++) {
+        if (totals[i] < 0.0) continue;
+
+        Timer& timer = timers[i];
+        if (timer.samples.size() < WINDOW_SIZE) {
+            timer.samples.push_back(totals[i]);
+        } else {
+            timer.samples[timer.next] = totals[i];
+        }
+        timer.next = (timer.next + 1) % WINDOW_SIZE;
+
+        if (keep_history) timer.history.push_back(totals[i]);
+    }
+}
+
+void GPUProfiler::dump(const std::string& path) const
+{
+    std::ofstream file(path.c_str());
+    if (!file) {
+        LOG.error("GPU_PROFILER::cannot write timers to %s", path.c_str());
+        return;
+    }
+
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (json) {
+        file << "{\n  \"timers\": [\n";
+        for (size_t i = 0; i < timers.size(); i++) {
+            const Timer& timer = timers[i];
+            file << "    {\"name\": \"" << timer.name << "\", \"average_ms\": " << timer.get_average()
+                 << ", \"min_ms\": " << timer.get_min() << ", \"max_ms\": " << timer.get_max()
+                 << ", \"samples\": " << timer.samples.size() << "}" << (i + 1 < timers.size() ? "," : "") << "\n";
+        }
+        file << "  ],\n  \"frame_ms\": " << get_frame_time() << "\n}\n";
+    } else {
+        file << "pass,average_ms,min_ms,max_ms,samples\n";
+        for (auto& timer : timers) {
+            file << timer.name << "," << timer.get_average() << "," << timer.get_min() << ","
+                 << timer.get_max() << "," << timer.samples.size() << "\n";
+        }
+    }
+
+    LOG.info("GPU_PROFILER::timers written to %s", path.c_str());
+}
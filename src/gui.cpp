@@ -2,24 +2,11 @@
 #include "config.h"
 #include "log_manager.h"
 
-static GLuint gui_VAO;
-static GLuint gui_VBO;
-
-void GUIWidget::setup_gui()
-{
-    glGenVertexArrays(1, &gui_VAO);
-    glGenBuffers(1, &gui_VBO);
-    glBindVertexArray(gui_VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, gui_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-}
+#include <algorithm>
 
 GUIWidget::GUIWidget(float left, float top, float width, float height) : Overlay(Overlay::Technique::GUI_ELEMENT),
-                                                                         left(left), top(top), width(width), height(height)
+                                                                         left(left), top(top), width(width), height(height),
+                                                                         geometry_dirty(true)
 {
 }
 
@@ -77,56 +64,38 @@ void GUILabel::set_top(float t)
 
 void GUILabel::draw(Renderer& renderer)
 {
-    glm::mat4 proj = glm::ortho(0.0f, (float)g_screen_width, 0.0f, (float)g_screen_height);
-
     if (background) {
-        renderer.use_shader(Renderer::GUI_SHADER);
-        renderer.uniform("uProjection", 1, false, glm::value_ptr(proj));
-
-        glDisable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        glBindVertexArray(gui_VAO);
-        glActiveTexture(GL_TEXTURE0);
-        background->bind(Renderer::DIFFUSE_TEXTURE_TARGET);
-
-        GLfloat vertices[6][4] = {
-            { left,     top,   0.0, 0.0 },
-            { left,     top - height,       0.0, 1.0 },
-            { left + width * mask_width, top - height,       mask_width, 1.0 },
-
-            { left,     top,   0.0, 0.0 },
-            { left + width * mask_width, top - height,       mask_width, 1.0 },
-            { left + width * mask_width, top,   mask_width, 0.0 }
-        };
-
-        glBindBuffer(GL_ARRAY_BUFFER, gui_VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        if (geometry_dirty) {
+            GLfloat right = left + width * mask_width, bottom = top - height;
+            GLfloat vertices[6][OverlayBatch::VERTEX_FLOATS] = {
+                { left,     top,   0.0, 0.0, 1.0, 1.0, 1.0 },
+                { left,     bottom,       0.0, 1.0, 1.0, 1.0, 1.0 },
+                { right, bottom,       mask_width, 1.0, 1.0, 1.0, 1.0 },
+
+                { left,     top,   0.0, 0.0, 1.0, 1.0, 1.0 },
+                { right, bottom,       mask_width, 1.0, 1.0, 1.0, 1.0 },
+                { right, top,   mask_width, 0.0, 1.0, 1.0, 1.0 }
+            };
+            std::copy(&vertices[0][0], &vertices[0][0] + 6 * OverlayBatch::VERTEX_FLOATS, &background_vertices[0][0]);
+            geometry_dirty = false;
+        }
 
-        glDisable(GL_BLEND);
-        glEnable(GL_DEPTH_TEST);
+        renderer.get_overlay_batch().add_sprite(background.get(), &background_vertices[0][0], 6);
     }
 
-    renderer.use_shader(Renderer::TEXT_OVERLAY_SHADER);
-    renderer.uniform("uProjection", 1, false, glm::value_ptr(proj));
-
+    /* drawn on top of all backgrounds by the overlay batch */
     text->draw(renderer);
 }
 
-void GUILabel::handle_mouse(double xpos, double ypos)
+bool GUILabel::handle_mouse(double xpos, double ypos)
 {
-    if (!enabled) return;
+    if (!enabled) return false;
 
     if (!hit_test(xpos, ypos)) {
-        if (mouse_state == MOUSE_HOVER) text->set_color(saved_color);
+        bool changed = mouse_state == MOUSE_HOVER;
+        if (changed) text->set_color(saved_color);
         mouse_state = MOUSE_OUTSIDE;
-        return;
+        return changed;
     }
 
     int mouse = glfwGetMouseButton(g_window, GLFW_MOUSE_BUTTON_LEFT);
@@ -139,6 +108,7 @@ void GUILabel::handle_mouse(double xpos, double ypos)
             if (saved_color[0] == 0.0f && saved_color[1] == 0.0f && saved_color[2] == 0.0f) new_color = {0.2f, 0.2f, 0.2f};
             text->set_color(new_color);
             mouse_state = MOUSE_HOVER;
+            return true;
         }
     } else {
         if (mouse_state != MOUSE_PRESSED) {
@@ -149,4 +119,5 @@ void GUILabel::handle_mouse(double xpos, double ypos)
             }
         }
     }
+    return false;
 }
@@ -10,11 +10,15 @@
 #include "text_overlay.h"
 #include "controllers.h"
 #include "gui.h"
+#include "profiler.h"
+#include "benchmark.h"
+#include "random_utils.h"
 
 #include "characters.h"
 
 // System Headers
 #include <GLFW/glfw3.h>
+#include <iostream>
 
 using namespace std;
 
@@ -66,11 +70,50 @@ void load_config()
 
 		g_MSAA = graphics_config.get("MSAA", "0").asInt();
 
+        /* texel budget of the shadow atlases, the size should be a power of two */
+        g_shadow_atlas_size = graphics_config.get("shadow_atlas_size", 4096).asInt();
+        g_shadow_lights = graphics_config.get("shadow_lights", 4).asInt();
+        if (g_shadow_atlas_size < 512 || (g_shadow_atlas_size & (g_shadow_atlas_size - 1)))
+            THROW_EXCEPT(E_INVALID_PARAM, "load_config()", "Bad shadow atlas size argument");
+
+        string shadow_technique = graphics_config.get("shadow_technique", "cube").asString();
+        if (shadow_technique == "cube") g_shadow_technique = Renderer::ShadowTechnique::CUBE_MAP;
+        else if (shadow_technique == "paraboloid") g_shadow_technique = Renderer::ShadowTechnique::DUAL_PARABOLOID;
+        else THROW_EXCEPT(E_INVALID_PARAM, "load_config()", "Bad shadow technique argument '" + shadow_technique + "'");
+
+        /* SSAO quality tiers: resolution divisor and kernel samples */
+        string ssao_quality = graphics_config.get("ssao_quality", "medium").asString();
+        if (ssao_quality == "low") { g_ssao_scale = 4; g_ssao_samples = 8; }
+        else if (ssao_quality == "medium") { g_ssao_scale = 2; g_ssao_samples = 16; }
+        else if (ssao_quality == "high") { g_ssao_scale = 2; g_ssao_samples = 32; }
+        else if (ssao_quality == "ultra") { g_ssao_scale = 1; g_ssao_samples = 64; }
+        else THROW_EXCEPT(E_INVALID_PARAM, "load_config()", "Bad SSAO quality argument '" + ssao_quality + "'");
+
+        /* bloom chain depth and extra blur iterations on its smallest level */
+        g_bloom_mips = graphics_config.get("bloom_mips", 6).asInt();
+        g_bloom_iterations = graphics_config.get("bloom_iterations", 1).asInt();
+        if (g_bloom_mips < 1 || g_bloom_mips > 10)
+            THROW_EXCEPT(E_INVALID_PARAM, "load_config()", "Bad bloom mips argument");
+        if (g_bloom_iterations < 0)
+            THROW_EXCEPT(E_INVALID_PARAM, "load_config()", "Bad bloom iterations argument");
+
+        /* features of the final composite pass */
+        g_bloom = (graphics_config.get("bloom", "true").asString() == "true");
+        g_vignette = (graphics_config.get("vignette", "false").asString() == "true");
+        string post_aa = graphics_config.get("post_aa", "fxaa").asString();
+        if (post_aa == "fxaa") g_fxaa = true;
+        else if (post_aa == "none") g_fxaa = false;
+        else THROW_EXCEPT(E_INVALID_PARAM, "load_config()", "Bad post AA argument '" + post_aa + "'");
+
+        /* per pass GPU timers, written to the dump file on exit if one is given */
+        g_gpu_timers = (graphics_config.get("gpu_timers", "false").asString() == "true");
+        g_gpu_timer_dump = graphics_config.get("gpu_timer_dump", "").asString();
+
         g_font = graphics_config.get("font", "DejaVuSerif").asString();
     }
 }
 
-void setup_context()
+void setup_context(bool benchmark)
 {
     if (!LogManager::get_singleton_ptr()) {
         new LogManager();
@@ -78,6 +121,8 @@ void setup_context()
     }
 
     load_config();
+    /* the benchmark reports the pass timers */
+    if (benchmark) g_gpu_timers = true;
 
     // Init GLFW
     glfwInit();
@@ -86,6 +131,8 @@ void setup_context()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    /* the benchmark renders into the back buffer of a hidden window */
+    if (benchmark) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	if (g_MSAA > 0) {
 		glfwWindowHint(GLFW_SAMPLES, g_MSAA);
@@ -101,6 +148,7 @@ void setup_context()
 
     // Load OpenGL library
     gladLoadGL();
+    if (benchmark) glfwSwapInterval(0);
 
     new Renderer();
     RENDERER.set_viewport(g_screen_width, g_screen_height);
@@ -111,11 +159,35 @@ void setup_context()
 	new ParticleSystem();
 
     TextOverlay::setup_font(g_font);
-    GUIWidget::setup_gui();
 }
 
+/* seconds a static screen sleeps at most without input */
+static const double IDLE_WAIT_TIMEOUT = 0.5;
+
+/* F3 toggles the GPU timer overlay, F12 writes the timers to the dump file */
+static bool show_gpu_timers = false;
+
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
 {
+    if (action == GLFW_PRESS && RENDERER.get_gpu_profiler().is_enabled()) {
+        if (key == GLFW_KEY_F3) {
+            show_gpu_timers = !show_gpu_timers;
+            return;
+        }
+        if (key == GLFW_KEY_F12) {
+            RENDERER.get_gpu_profiler().dump(g_gpu_timer_dump.empty() ? "gpu_timers.csv" : g_gpu_timer_dump);
+            return;
+        }
+    }
+
+#ifdef _PROFILE_
+    /* F11 exports the CPU zones */
+    if (action == GLFW_PRESS && key == GLFW_KEY_F11) {
+        Profiler::write_chrome_trace("trace.json");
+        return;
+    }
+#endif
+
     current_controller->handle_key(key, scancode, action, mode);
 }
 
@@ -130,12 +202,36 @@ void show_stat(float dt)
     static char stats[1000];
 
     auto pos = CHARACTER_MANAGER.main_char().get_camera().get_position();
-    sprintf(stats, "fps: %d, x = %f, y = %f, z = %f", (int) (1 / dt), pos[0], pos[1], pos[2]);
+    const GLState& gl_state = RENDERER.get_gl_state();
+    sprintf(stats, "fps: %d, x = %f, y = %f, z = %f, state calls: %u (%u filtered)", (int) (1 / dt), pos[0], pos[1], pos[2],
+            gl_state.get_issued_calls(), gl_state.get_filtered_calls());
 
     text->set_text(stats);
     text->set_y(g_screen_height - 20);
 
     RENDERER.enqueue_overlay(text);
+
+    if (!show_gpu_timers) return;
+
+    /* one line per pass, averaged over the profiler window */
+    static std::vector<std::shared_ptr<TextOverlay> > timer_lines;
+    const GPUProfiler& profiler = RENDERER.get_gpu_profiler();
+    for (size_t i = 0; i <= profiler.get_num_timers(); i++) {
+        if (i == timer_lines.size()) {
+            timer_lines.push_back(std::make_shared<TextOverlay>("", 0.0f, 0.0f, glm::vec3(1.0f, 1.0f, 0.6f), 0.35));
+        }
+
+        if (i < profiler.get_num_timers()) {
+            const GPUProfiler::Timer& timer = profiler.get_timer(i);
+            sprintf(stats, "%-18s %6.3f ms (max %6.3f)", timer.name.c_str(), timer.get_average(), timer.get_max());
+        } else {
+            sprintf(stats, "%-18s %6.3f ms", "GPU total", profiler.get_frame_time());
+        }
+
+        timer_lines[i]->set_text(stats);
+        timer_lines[i]->set_y(g_screen_height - 40 - 16 * i);
+        RENDERER.enqueue_overlay(timer_lines[i]);
+    }
 }
 
 void Controller::switch_controller(const string& name)
@@ -146,9 +242,40 @@ void Controller::switch_controller(const string& name)
 }
 
 // The MAIN function, from here we start the application and run the game loop
-int main()
+int main(int argc, char* argv[])
 {
-    setup_context();
+    /* --bench-render [--bench-frames N] [--bench-warmup N] [--bench-output file] */
+    bool benchmark = false;
+    int bench_frames = 1000, bench_warmup = 60;
+    string bench_output = "bench_render.json";
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "--bench-render") benchmark = true;
+        else if (arg == "--bench-frames" && i + 1 < argc) bench_frames = StringUtils::parse_int(argv[++i], bench_frames);
+        else if (arg == "--bench-warmup" && i + 1 < argc) bench_warmup = StringUtils::parse_int(argv[++i], bench_warmup);
+        else if (arg == "--bench-output" && i + 1 < argc) bench_output = argv[++i];
+        else {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (bench_frames < 1 || bench_warmup < 0) {
+        std::cerr << "Benchmark needs at least 1 frame and a non-negative warmup" << std::endl;
+        return 1;
+    }
+
+    setup_context(benchmark);
+
+    if (benchmark) {
+        RandomUtils::seed(RenderBenchmark::MAP_SEED);
+        MapGenerator::seed(RenderBenchmark::MAP_SEED);
+        g_map = new Map(g_map_width, g_map_height);
+
+        RenderBenchmark(bench_frames, bench_warmup, bench_output).run();
+        glfwTerminate();
+        return 0;
+    }
+
     LOG.info("Starting game...");
 
 	g_map = new Map(g_map_width, g_map_height);
@@ -170,7 +297,9 @@ int main()
     while (!glfwWindowShouldClose(g_window))
     {
         // Check if any events have been activiated (key pressed, mouse moved etc.) and call corresponding response functions
-        glfwPollEvents();
+        /* nothing moves behind a menu, sleep until there is input */
+        if (current_controller->is_static()) glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+        else glfwPollEvents();
 
         if (glfwGetMouseButton(g_window, GLFW_MOUSE_BUTTON_LEFT)) {
             double xpos, ypos;
@@ -178,23 +307,59 @@ int main()
             mouse_callback(g_window, xpos, ypos);
         }
 
+        PROFILE_ZONE("frame");
+
         current_time = glfwGetTime();
         float dt = (float) current_time - (float) last_time;
         last_time = current_time;
-        ANIMATION_MANAGER.update(dt);
-		PARTICLE_SYSTEM.update(dt);
-        SIMULATION.update(dt);
-		CHARACTER_MANAGER.update(dt);
+
+        /* the input above may have switched the screen */
+        if (current_controller->is_static()) {
+            RENDERER.begin_frame();
+            current_controller->update_view(RENDERER);
+            RENDERER.end_static_frame(current_controller->poll_redraw());
+            glfwSwapBuffers(g_window);
+            continue;
+        }
+        {
+            PROFILE_ZONE("AnimationManager::update");
+            ANIMATION_MANAGER.update(dt);
+        }
+        {
+            PROFILE_ZONE("ParticleSystem::update");
+            PARTICLE_SYSTEM.update(dt);
+        }
+        {
+            PROFILE_ZONE("Simulation::update");
+            SIMULATION.update(dt);
+        }
+        {
+            PROFILE_ZONE("CharacterManager::update");
+            CHARACTER_MANAGER.update(dt);
+        }
 
         RENDERER.begin_frame();
         if (dt > 0) {
             show_stat(dt);
         }
-        current_controller->update_view(RENDERER);
-        RENDERER.end_frame();
-
-        glfwSwapBuffers(g_window);
+        {
+            PROFILE_ZONE("Controller::update_view");
+            current_controller->update_view(RENDERER);
+        }
+        {
+            PROFILE_ZONE("Renderer::end_frame");
+            RENDERER.end_frame();
+        }
+        {
+            PROFILE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(g_window);
+        }
     }
+    if (!g_gpu_timer_dump.empty() && RENDERER.get_gpu_profiler().is_enabled()) {
+        RENDERER.get_gpu_profiler().dump(g_gpu_timer_dump);
+    }
+    TextOverlay::save_font_cache();
+
     // Properly de-allocate all resources once they've outlived their purpose
     // Terminate GLFW, clearing any resources allocated by GLFW.
     glfwTerminate();
@@ -8,6 +8,7 @@
 #include "particle_system.h"
 #include "random_utils.h"
 #include "simulation.h"
+#include "profiler.h"
 
 #include <glm/gtc/type_ptr.hpp>
 #include <random>
@@ -21,16 +22,27 @@ Map::Map(int width, int height) : width(width), height(height), generator(width,
     generator.generate(width, g_difficulty);
     generator.print();
     setup_mesh();
+    RENDERER.invalidate_minimap();
 }
 
 void Map::draw(Renderer& renderer)
 {
-    renderer.uniform(ShaderProgram::BONE_TRANSFORMS, 1, false, glm::value_ptr(glm::mat4()));
+    renderer.use_identity_bones();
     map_mesh->draw(renderer);
 }
 
+void Map::set_tile(int i, int j, char tile)
+{
+    if (generator.getTile(i, j) == tile) return;
+
+    generator.setTile(i, j, tile);
+    RENDERER.invalidate_minimap_tile(i, j);
+}
+
 void Map::setup_mesh()
 {
+    PROFILE_ZONE("Map::setup_mesh");
+
     std::vector<Vertex> vertices;
     std::vector<GLuint> indices;
 
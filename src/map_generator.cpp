@@ -37,6 +37,11 @@ MapGenerator::MapGenerator(int width, int height)
 {
 }
 
+void MapGenerator::seed(unsigned int value)
+{
+    mt.seed(value);
+}
+
 void MapGenerator::generate(int maxFeatures, MapGenerator::Difficulty h)
 {
     // place the first room in the center
@@ -264,6 +269,7 @@ bool MapGenerator::makeRoom(int x, int y, Direction dir, bool firstRoom)
     if (placeRect(room, Floor))
     {
         _rooms.emplace_back(room);
+        _all_rooms.emplace_back(room);
 
         if (dir != South || firstRoom) // north side
             _exits.emplace_back(Rect{ room.x, room.y - 1, room.width, 1 });
@@ -1,4 +1,5 @@
 #include "material.h"
+#include "renderer.h"
 #include "log_manager.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb.h>
@@ -23,7 +24,7 @@ void MaterialTexture::load_texture()
 
     GLuint texture;
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture); // All upcoming GL_TEXTURE_2D operations now have effect on our texture object
+    GL_STATE.bind_texture(GL_TEXTURE_2D, texture); // All upcoming GL_TEXTURE_2D operations now have effect on our texture object
     // Set our texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// Set texture wrapping to GL_REPEAT
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -38,15 +39,15 @@ void MaterialTexture::load_texture()
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
     glGenerateMipmap(GL_TEXTURE_2D);
     stbi_image_free(image);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GL_STATE.bind_texture(GL_TEXTURE_2D, 0);
 
     handle = texture;
 }
 
 void MaterialTexture::bind(GLuint target)
 {
-    glActiveTexture(target);
-    glBindTexture(GL_TEXTURE_2D, handle);
+    GL_STATE.active_texture(target);
+    GL_STATE.bind_texture(GL_TEXTURE_2D, handle);
 }
 
 PMaterialTexture MaterialTexture::create_texture(const std::string& name)
@@ -61,8 +62,11 @@ PMaterialTexture MaterialTexture::create_texture(const std::string& name)
     return it->second;
 }
 
+int Material::next_id = 1;
+
 Material::Material(float roughness, float metallic, const std::string& diffuse_texture, const std::string& normal_map)
 {
+    this->id = next_id++;
     this->roughness = roughness;
     this->metallic = metallic;
     this->diffuse_texture = MaterialTexture::create_texture(diffuse_texture);
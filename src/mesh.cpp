@@ -2,11 +2,14 @@
 #include "log_manager.h"
 #include "renderer.h"
 #include "exception.h"
+#include "profiler.h"
 
 #include <glm/gtc/type_ptr.hpp>
 
 using namespace std;
 
+static const float SKINNED_BOUND_SCALE = 1.5f;
+
 template <typename RM, typename CM>
 void copy_matrix(const RM& from, CM& to)
 {
@@ -30,20 +33,15 @@ Mesh::Mesh(aiNode* scene_root, const std::vector<Vertex>& vertices, const std::v
     this->bones = bones;
     this->global_transform_inverse = global_transform_inverse;
     this->setup_mesh();
+
+    for (auto& vertex : vertices) {
+        bound.expand(glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]));
+    }
 }
 
 void Mesh::draw(Renderer& renderer)
 {
-    if (material) {
-        material->get_diffuse_texture()->bind(Renderer::DIFFUSE_TEXTURE_TARGET);
-        material->get_normal_map()->bind(Renderer::NORMAL_MAP_TARGET);
-        renderer.uniform(ShaderProgram::MAT_METALLIC, material->get_metallic());
-        renderer.uniform(ShaderProgram::MAT_ROUGHNESS, material->get_roughness());
-    }
-
-    glBindVertexArray(this->VAO);
-    glDrawElements(GL_TRIANGLES, this->indices.size(),GL_UNSIGNED_INT,0);
-    glBindVertexArray(0);
+    renderer.submit(this->VAO, this->indices.size(), material.get(), bound);
 }
 
 void Mesh::setup_mesh()
@@ -52,7 +50,7 @@ void Mesh::setup_mesh()
     glGenBuffers(1,&this->VBO);
     glGenBuffers(1,&this->EBO);
 
-    glBindVertexArray(this->VAO);
+    GL_STATE.bind_vertex_array(this->VAO);
     glBindBuffer(GL_ARRAY_BUFFER,this->VBO);
 
     glBufferData(GL_ARRAY_BUFFER,this->vertices.size() * sizeof(Vertex),&this->vertices[0],GL_STATIC_DRAW);
@@ -78,7 +76,7 @@ void Mesh::setup_mesh()
     glEnableVertexAttribArray(5);
     glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, tangent));
 
-    glBindVertexArray(0);
+    GL_STATE.bind_vertex_array(0);
 }
 
 void Mesh::update_bone_transform(aiAnimation* animation, float time_sec, std::vector<glm::mat4>& transforms)
@@ -88,7 +86,11 @@ void Mesh::update_bone_transform(aiAnimation* animation, float time_sec, std::ve
     float time_tick = time_sec * tick_per_sec;
     float animation_time = fmod(time_tick, animation->mDuration);
 
-    read_node_hierarchy(animation, animation_time, scene_root, glm::mat4());
+    {
+        /* zone around the whole recursion rather than every node */
+        PROFILE_ZONE("Mesh::read_node_hierarchy");
+        read_node_hierarchy(animation, animation_time, scene_root, glm::mat4());
+    }
 
     transforms.resize(bones.size());
 
@@ -241,6 +243,10 @@ void Model::load_model(std::string path) {
     this->directory = path.substr(0,path.find_last_of('/'));
     process_materials(scene);
     this->process_node(scene->mRootNode, scene);
+
+    for (auto& mesh : meshes) {
+        bound.expand(mesh.bound);
+    }
 }
 
 void Model::load_animation(InternString name, std::string path, int idx)
@@ -350,7 +356,14 @@ Mesh Model::process_mesh(aiMesh* mesh, const aiScene* scene){
 
     glm::mat4 global_transform;
     copy_matrix(scene->mRootNode->mTransformation, global_transform);
-    return Mesh(scene->mRootNode, vertices, indices, material, bones, glm::inverse(global_transform));
+    Mesh result(scene->mRootNode, vertices, indices, material, bones, glm::inverse(global_transform));
+
+    /* animated vertices leave the bind pose, keep some slack so that limbs are not culled */
+    if (mesh->mNumBones) {
+        result.bound.scale(SKINNED_BOUND_SCALE);
+    }
+
+    return result;
 }
 
 void Model::process_materials(const aiScene* scene)
@@ -0,0 +1,99 @@
+#include "overlay_batch.h"
+#include "renderer.h"
+#include "text_overlay.h"
+#include "stream_buffer.h"
+#include "material.h"
+#include "config.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+OverlayBatch::OverlayBatch() : VAO(0), stream_generation(0), num_draws(0)
+{
+}
+
+void OverlayBatch::setup()
+{
+    glGenVertexArrays(1, &VAO);
+}
+
+void OverlayBatch::add_sprite(MaterialTexture* texture, const GLfloat* vertices, size_t num_vertices)
+{
+    if (runs.empty() || runs.back().texture != texture) {
+        Run run;
+        run.texture = texture;
+        run.first = sprite_vertices.size() / VERTEX_FLOATS;
+        run.count = 0;
+        runs.push_back(run);
+    }
+
+    runs.back().count += num_vertices;
+    sprite_vertices.insert(sprite_vertices.end(), vertices, vertices + num_vertices * VERTEX_FLOATS);
+}
+
+void OverlayBatch::add_text(const GLfloat* vertices, size_t num_vertices)
+{
+    text_vertices.insert(text_vertices.end(), vertices, vertices + num_vertices * VERTEX_FLOATS);
+}
+
+void OverlayBatch::flush(Renderer& renderer)
+{
+    num_draws = 0;
+    if (sprite_vertices.empty() && text_vertices.empty()) return;
+
+    /* sprites followed by text in one write, the text draw starts after the sprites */
+    GLsizei num_sprite_vertices = sprite_vertices.size() / VERTEX_FLOATS;
+    sprite_vertices.insert(sprite_vertices.end(), text_vertices.begin(), text_vertices.end());
+
+    StreamBuffer& stream = renderer.get_stream_buffer();
+    GLint first = stream.write(&sprite_vertices[0], sprite_vertices.size() * sizeof(GLfloat),
+                               VERTEX_FLOATS * sizeof(GLfloat)) / (VERTEX_FLOATS * sizeof(GLfloat));
+
+    GL_STATE.bind_vertex_array(VAO);
+    if (stream_generation != stream.get_generation()) {
+        stream_generation = stream.get_generation();
+        glBindBuffer(GL_ARRAY_BUFFER, stream.get_buffer());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(GLfloat), 0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(GLfloat), (void*)(4 * sizeof(GLfloat)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    glm::mat4 proj = glm::ortho(0.0f, (float)g_screen_width, 0.0f, (float)g_screen_height);
+
+    GL_STATE.disable(GL_DEPTH_TEST);
+    GL_STATE.enable(GL_BLEND);
+    GL_STATE.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (!runs.empty()) {
+        renderer.use_shader(Renderer::GUI_SHADER);
+        renderer.uniform("uProjection", 1, false, glm::value_ptr(proj));
+
+        for (auto& run : runs) {
+            run.texture->bind(Renderer::DIFFUSE_TEXTURE_TARGET);
+            glDrawArrays(GL_TRIANGLES, first + run.first, run.count);
+            num_draws++;
+        }
+    }
+
+    if (!text_vertices.empty()) {
+        renderer.use_shader(Renderer::TEXT_OVERLAY_SHADER);
+        renderer.uniform("uProjection", 1, false, glm::value_ptr(proj));
+
+        GL_STATE.active_texture(GL_TEXTURE0);
+        GL_STATE.bind_texture(GL_TEXTURE_2D, TextOverlay::get_atlas());
+        glDrawArrays(GL_TRIANGLES, first + num_sprite_vertices, text_vertices.size() / VERTEX_FLOATS);
+        num_draws++;
+    }
+    TextOverlay::end_batch();
+
+    GL_STATE.bind_vertex_array(0);
+    GL_STATE.bind_texture(GL_TEXTURE_2D, 0);
+
+    GL_STATE.disable(GL_BLEND);
+    GL_STATE.enable(GL_DEPTH_TEST);
+
+    sprite_vertices.clear();
+    text_vertices.clear();
+    runs.clear();
+}
@@ -5,7 +5,7 @@ Billboard::Billboard(glm::vec3 pos, float width, float height, const std::string
 	glGenVertexArrays(1, &vao);
 	GLuint vbo;
 	glGenBuffers(1, &vbo);
-	glBindVertexArray(vao);
+	GL_STATE.bind_vertex_array(vao);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(pos), &pos, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
@@ -18,11 +18,17 @@ void Billboard::draw(Renderer& renderer)
 {
 	renderer.uniform("uBillboardWidth", width);
 	renderer.uniform("uBillboardHeight", height);
-	glBindVertexArray(vao);
-	glActiveTexture(0);
+	GL_STATE.bind_vertex_array(vao);
 	texture->bind(GL_TEXTURE0);
 	glDrawArrays(GL_POINTS, 0, 1);
-	glBindVertexArray(0);
+}
+
+AABB Billboard::get_bound() const
+{
+	/* the quad is expanded around pos facing the camera */
+	float radius = 0.5f * glm::max(width, height);
+	glm::vec3 extents(radius, radius, radius);
+	return AABB(pos - extents, pos + extents);
 }
 
 FlameParticle::FlameParticle(glm::vec3 pos) : Particle(pos, 0.5f, 0.5f, "FlameParticle1_I.jpg")
@@ -12,7 +12,10 @@ void ParticleSystem::update(float dt)
 
 void ParticleSystem::submit(Renderer& renderer)
 {
+	/* particles are forward shaded and cast no shadow */
 	for (auto& p : particles) {
-		renderer.enqueue_renderable(p);
+		if (renderer.is_visible(p->get_bound())) {
+			renderer.enqueue_renderable(p);
+		}
 	}
 }
@@ -0,0 +1,101 @@
+#include "profiler.h"
+
+#ifdef _PROFILE_
+
+#include "log_manager.h"
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <fstream>
+
+namespace {
+
+struct ZoneEvent {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+/* written only by its own thread, head is published so that an export sees complete events */
+struct ThreadBuffer {
+    int thread_id;
+    std::vector<ZoneEvent> events;
+    std::atomic<uint64_t> head;
+
+    explicit ThreadBuffer(int thread_id) : thread_id(thread_id), events(Profiler::RING_SIZE), head(0) { }
+};
+
+std::mutex buffers_mutex;
+std::vector<std::shared_ptr<ThreadBuffer> > buffers;
+
+ThreadBuffer& get_thread_buffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        buffer = std::make_shared<ThreadBuffer>(buffers.size());
+        buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+}
+
+void Profiler::record(const char* name, uint64_t begin, uint64_t end)
+{
+    ThreadBuffer& buffer = get_thread_buffer();
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+
+    ZoneEvent& event = buffer.events[head % RING_SIZE];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+bool Profiler::write_chrome_trace(const std::string& path)
+{
+    std::ofstream file(path.c_str());
+    if (!file) {
+        LOG.error("PROFILER::cannot write trace to %s", path.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+
+    /* timestamps relative to the oldest zone still in the buffers */
+    uint64_t origin = UINT64_MAX;
+    for (auto& buffer : buffers) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = head > RING_SIZE ? head - RING_SIZE : 0;
+        for (uint64_t i = first; i < head; i++) {
+            const ZoneEvent& event = buffer->events[i % RING_SIZE];
+            if (event.begin < origin) origin = event.begin;
+        }
+    }
+
+    file << "{\"traceEvents\":[";
+    bool first_event = true;
+    for (auto& buffer : buffers) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        /* zones the owner may be overwriting while we read are skipped */
+        uint64_t first = head > RING_SIZE ? head - RING_SIZE + 1 : 0;
+        for (uint64_t i = first; i < head; i++) {
+            const ZoneEvent& event = buffer->events[i % RING_SIZE];
+
+            file << (first_event ? "\n" : ",\n");
+            file << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+                 << ",\"ts\":" << (event.begin - origin) / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+            first_event = false;
+        }
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    LOG.info("PROFILER::trace written to %s", path.c_str());
+    return true;
+}
+
+#endif
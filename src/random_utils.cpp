@@ -20,6 +20,11 @@ int RandomUtils::random_int(int min, int max) // inclusive min/max
     return dist(mt) + min;
 }
 
+void RandomUtils::seed(unsigned int value)
+{
+    mt.seed(value);
+}
+
 bool RandomUtils::random_bool(double probability)
 {
     std::bernoulli_distribution dist(probability);
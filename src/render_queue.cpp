@@ -0,0 +1,124 @@
+#include "render_queue.h"
+
+#include <cstring>
+#include <algorithm>
+
+uint64_t RenderQueue::make_key(Pass pass, GLuint shader, int material, GLuint vao, float depth)
+{
+    if (depth < 0.0f) depth = 0.0f;
+    if (depth > 1.0f) depth = 1.0f;
+
+    return ((uint64_t) pass << PASS_SHIFT) |
+           ((uint64_t) (shader & 0x3f) << SHADER_SHIFT) |
+           ((uint64_t) (material & 0xffff) << MATERIAL_SHIFT) |
+           ((uint64_t) (vao & 0xffff) << VAO_SHIFT) |
+           ((uint64_t) (depth * DEPTH_MASK) & DEPTH_MASK);
+}
+
+void RenderQueue::clear()
+{
+    draws.clear();
+    commands.clear();
+    batches.clear();
+    bones.clear();
+}
+
+int RenderQueue::push_bones(GLsizei count, const GLfloat* transforms)
+{
+    int offset = bones.size();
+    bones.resize(offset + count);
+    memcpy(&bones[offset][0][0], transforms, count * sizeof(glm::mat4));
+    return offset;
+}
+
+uint32_t RenderQueue::push_draw(const DrawItem& draw)
+{
+    draws.push_back(draw);
+    return draws.size() - 1;
+}
+
+void RenderQueue::push_command(uint64_t key, uint32_t draw)
+{
+    Command cmd;
+    cmd.key = key;
+    cmd.draw = draw;
+    commands.push_back(cmd);
+}
+
+void RenderQueue::sort()
+{
+    batches.clear();
+    if (commands.empty()) return;
+
+    sort_buffer.resize(commands.size());
+
+    /* LSD radix sort, one byte of the key per round */
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t count[256] = { 0 };
+        for (auto& cmd : commands) {
+            count[(cmd.key >> shift) & 0xff]++;
+        }
+
+        /* all keys share this digit */
+        if (count[(commands[0].key >> shift) & 0xff] == commands.size()) continue;
+
+        size_t offset = 0;
+        for (int i = 0; i < 256; i++) {
+            size_t c = count[i];
+            count[i] = offset;
+            offset += c;
+        }
+
+        for (auto& cmd : commands) {
+            sort_buffer[count[(cmd.key >> shift) & 0xff]++] = cmd;
+        }
+        commands.swap(sort_buffer);
+    }
+
+    build_batches();
+}
+
+void RenderQueue::build_batches()
+{
+    Batch batch;
+    batch.first = 0;
+    batch.count = 1;
+
+    for (uint32_t i = 1; i < commands.size(); i++) {
+        /* same state if everything above the depth bits matches. the key only keeps the low bits of
+         * the material id and the vao name, so draws that collide there are told apart by the draw
+         * itself. the depth only passes do not use the material */
+        const DrawItem& first = draws[commands[batch.first].draw];
+        const DrawItem& draw = draws[commands[i].draw];
+        uint64_t pass = commands[i].key >> PASS_SHIFT;
+        if ((commands[i].key >> VAO_SHIFT) == (commands[batch.first].key >> VAO_SHIFT) && draw.vao == first.vao &&
+            (pass != GEOMETRY_PASS || draw.material == first.material)) {
+            batch.count++;
+            continue;
+        }
+
+        batches.push_back(batch);
+        batch.first = i;
+        batch.count = 1;
+    }
+    batches.push_back(batch);
+}
+
+void RenderQueue::get_pass_batches(Pass pass, size_t& begin, size_t& end) const
+{
+    uint64_t p = (uint64_t) pass;
+    const std::vector<Command>& cmds = commands;
+    auto batch_pass = [&cmds](const Batch& batch) { return cmds[batch.first].key >> PASS_SHIFT; };
+
+    auto first = std::partition_point(batches.begin(), batches.end(),
+                                      [&](const Batch& batch) { return batch_pass(batch) < p; });
+    auto last = std::partition_point(first, batches.end(),
+                                     [&](const Batch& batch) { return batch_pass(batch) <= p; });
+    begin = first - batches.begin();
+    end = last - batches.begin();
+}
+
+int RenderQueue::get_batch_material(size_t batch) const
+{
+    return (commands[batches[batch].first].key >> MATERIAL_SHIFT) & 0xffff;
+}
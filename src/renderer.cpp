@@ -5,12 +5,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <random>
+#include <algorithm>
 #include "renderer.h"
 #include "renderable.h"
 #include "config.h"
 #include "log_manager.h"
 #include "exception.h"
-#include "random_utils.h"
 #include "character_manager.h"
 template <>
 Renderer* Singleton<Renderer>::singleton = nullptr;
@@ -20,15 +20,21 @@ const float Renderer::Z_NEAR = 0.1f;
 const float Renderer::Z_FAR = 100.0f;
 const float Renderer::SHADOW_NEAR = 1.0f;
 const float Renderer::SHADOW_FAR = 25.0f;
+const float Renderer::LIGHT_CUTOFF = 1.0f / 32.0f;
 
 const GLuint MINIMAP_SIZE = 8;
+/* empty tiles around the map in the minimap texture, at least half of the view */
+const int MINIMAP_MARGIN = MINIMAP_SIZE / 2;
+const int MINIMAP_TILE_PIXELS = 32;
+/* bytes of streamed vertices per frame before the stream buffer grows */
+const GLsizeiptr STREAM_REGION_SIZE = 256 * 1024;
 
-Renderer::Renderer()
+Renderer::Renderer() : frame_graph(gl_state), stream_buffer(STREAM_REGION_SIZE)
 {
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     //glClearDepth(1.0f);
-    glEnable(GL_DEPTH_TEST);
-	glEnable(GL_MULTISAMPLE);
+    gl_state.enable(GL_DEPTH_TEST);
+	gl_state.enable(GL_MULTISAMPLE);
     //glEnable(GL_CULL_FACE);
 
     /* setup matrix stack */
@@ -40,43 +46,69 @@ Renderer::Renderer()
     use_shader(GEOMETRY_PASS_SHADER);
     geometry_pass->uniform(ShaderProgram::DIFFUSE_TEXTURE, 0);
     geometry_pass->uniform(ShaderProgram::NORMAL_MAP, 1);
+    geometry_pass->uniform("uInstanceData", 6);
+    geometry_pass->uniform("uBonePalette", 7);
 
     PShaderProgram lighting_pass(new ShaderProgram("resources/shaders/screen_quad.vert", "resources/shaders/lighting.frag"));
     shaders[LIGHTING_PASS_SHADER] = lighting_pass;
     use_shader(LIGHTING_PASS_SHADER);
-    lighting_pass->uniform(ShaderProgram::GBUFFER_POSITION, 0);
+    lighting_pass->uniform(ShaderProgram::GBUFFER_DEPTH, 0);
     lighting_pass->uniform(ShaderProgram::GBUFFER_NORMAL, 1);
     lighting_pass->uniform(ShaderProgram::GBUFFER_ALBEDO_SPEC, 2);
     lighting_pass->uniform("uSSAOInput", 3);
     lighting_pass->uniform("uDepthMap", 4);
     lighting_pass->uniform("uFarPlane", SHADOW_FAR);
+    lighting_pass->uniform("uLightData", 5);
+    lighting_pass->uniform("uClusterGrid", 6);
+    lighting_pass->uniform("uLightIndices", 7);
 
     PShaderProgram ssao_shader(new ShaderProgram("resources/shaders/screen_quad.vert", "resources/shaders/ssao.frag"));
     shaders[SSAO_SHADER] = ssao_shader;
     use_shader(SSAO_SHADER);
-    ssao_shader->uniform(ShaderProgram::GBUFFER_POSITION, 0);
+    ssao_shader->uniform(ShaderProgram::GBUFFER_DEPTH, 0);
     ssao_shader->uniform(ShaderProgram::GBUFFER_NORMAL, 1);
     ssao_shader->uniform("uNoiseTexture", 2);
 
-    PShaderProgram ssao_blur_shader(new ShaderProgram("resources/shaders/screen_quad.vert", "resources/shaders/ssao_blur.frag"));
-    shaders[SSAO_BLUR_SHADER] = ssao_blur_shader;
-    use_shader(SSAO_BLUR_SHADER);
-    ssao_blur_shader->uniform("uSSAOInput", 0);
+    PShaderProgram ssao_upsample_shader(new ShaderProgram("resources/shaders/screen_quad.vert", "resources/shaders/ssao_upsample.frag"));
+    shaders[SSAO_UPSAMPLE_SHADER] = ssao_upsample_shader;
+    use_shader(SSAO_UPSAMPLE_SHADER);
+    ssao_upsample_shader->uniform("uSSAOInput", 0);
+    ssao_upsample_shader->uniform(ShaderProgram::GBUFFER_DEPTH, 1);
+    ssao_upsample_shader->uniform(ShaderProgram::GBUFFER_NORMAL, 2);
 
-    PShaderProgram depth_map_shader(new ShaderProgram("resources/shaders/depth_map.vert", "resources/shaders/depth_map.frag", "resources/shaders/depth_map.geom"));
+    PShaderProgram depth_map_shader(new ShaderProgram("resources/shaders/depth_map.vert", "resources/shaders/depth_map.frag"));
     shaders[DEPTH_MAP_SHADER] = depth_map_shader;
-
-	PShaderProgram hdr_blend_shader(new ShaderProgram("resources/shaders/screen_quad.vert", "resources/shaders/hdr_blend.frag"));
-	shaders[HDR_BLEND_SHADER] = hdr_blend_shader;
-	use_shader(HDR_BLEND_SHADER);
-	hdr_blend_shader->uniform("uHDRInput", 0);
-	hdr_blend_shader->uniform("uBloomBlur", 1);
+    use_shader(DEPTH_MAP_SHADER);
+    depth_map_shader->uniform("uInstanceData", 6);
+    depth_map_shader->uniform("uBonePalette", 7);
+
+    /* the final composite is specialized by the enabled post-processing features */
+    std::vector<std::string> composite_defines;
+    if (g_bloom) composite_defines.push_back("USE_BLOOM");
+    if (g_fxaa) composite_defines.push_back("USE_FXAA");
+    if (g_vignette) composite_defines.push_back("USE_VIGNETTE");
+    PShaderProgram composite_shader(new ShaderProgram("resources/shaders/screen_quad.vert", "resources/shaders/composite.frag",
+                                                      nullptr, composite_defines));
+    shaders[COMPOSITE_SHADER] = composite_shader;
+    use_shader(COMPOSITE_SHADER);
+    composite_shader->uniform("uHDRInput", 0);
+    composite_shader->uniform("uBloomBlur", 1);
 
 	PShaderProgram gaussian_blur_shader(new ShaderProgram("resources/shaders/screen_quad.vert", "resources/shaders/gaussian_blur.frag"));
 	shaders[GAUSSIAN_BLUR_SHADER] = gaussian_blur_shader;
 	use_shader(GAUSSIAN_BLUR_SHADER);
 	gaussian_blur_shader->uniform("uInput", 0);
 
+    PShaderProgram bloom_downsample_shader(new ShaderProgram("resources/shaders/screen_quad.vert", "resources/shaders/bloom_downsample.frag"));
+    shaders[BLOOM_DOWNSAMPLE_SHADER] = bloom_downsample_shader;
+    use_shader(BLOOM_DOWNSAMPLE_SHADER);
+    bloom_downsample_shader->uniform("uInput", 0);
+
+    PShaderProgram bloom_upsample_shader(new ShaderProgram("resources/shaders/screen_quad.vert", "resources/shaders/bloom_upsample.frag"));
+    shaders[BLOOM_UPSAMPLE_SHADER] = bloom_upsample_shader;
+    use_shader(BLOOM_UPSAMPLE_SHADER);
+    bloom_upsample_shader->uniform("uInput", 0);
+
 	PShaderProgram billboard_shader(new ShaderProgram("resources/shaders/billboard.vert", "resources/shaders/billboard.frag", "resources/shaders/billboard.geom"));
 	shaders[BILLBOARD_SHADER] = billboard_shader;
 	use_shader(BILLBOARD_SHADER);
@@ -92,61 +124,112 @@ Renderer::Renderer()
     use_shader(GUI_SHADER);
     gui_shader->uniform("uText", 0);
 
+    PShaderProgram screen_copy_shader(new ShaderProgram("resources/shaders/screen_quad.vert", "resources/shaders/screen_copy.frag"));
+    shaders[SCREEN_COPY_SHADER] = screen_copy_shader;
+    use_shader(SCREEN_COPY_SHADER);
+    screen_copy_shader->uniform("uInput", 0);
+
     PShaderProgram minimap_shader(new ShaderProgram("resources/shaders/minimap.vert", "resources/shaders/minimap.frag"));
     shaders[MINIMAP_SHADER] = minimap_shader;
     use_shader(MINIMAP_SHADER);
     minimap_shader->uniform("uTexture", 0);
 
-    setup_gbuffer();
+    for (auto& it : shaders) {
+        it.second->bind_uniform_block("FrameData", FRAME_DATA_BINDING);
+        it.second->bind_uniform_block("DrawData", DRAW_DATA_BINDING);
+        it.second->bind_uniform_block("SSAOKernel", SSAO_KERNEL_BINDING);
+        it.second->bind_uniform_block("ShadowData", SHADOW_DATA_BINDING);
+    }
+
+    setup_uniform_buffers();
+    setup_instance_buffers();
+    setup_clusters();
     setup_quad();
     setup_SSAO();
-	setup_HDR();
     setup_shadow_map();
+    stream_buffer.setup();
+    setup_overlay_cache();
     setup_minimap();
+    overlay_batch.setup();
 
     enable_minimap = false;
+    gpu_profiler.set_enabled(g_gpu_timers);
+    bone_offset = 0;
+    submit_static = false;
+    num_shadow_faces = g_shadow_technique == ShadowTechnique::DUAL_PARABOLOID ? 2 : 6;
 }
 
-void Renderer::setup_gbuffer()
+void Renderer::setup_uniform_buffers()
 {
-    glGenFramebuffers(1, &gbuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, gbuffer);
-    // - Position color buffer
-    glGenTextures(1, &g_position);
-    glBindTexture(GL_TEXTURE_2D, g_position);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, g_screen_width, g_screen_height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_position, 0);
-    // - Normal color buffer
-    glGenTextures(1, &g_normal);
-    glBindTexture(GL_TEXTURE_2D, g_normal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, g_screen_width, g_screen_height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, g_normal, 0);
-    // - Color + Specular color buffer
-    glGenTextures(1, &g_albedo_spec);
-    glBindTexture(GL_TEXTURE_2D, g_albedo_spec);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, g_screen_width, g_screen_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, g_albedo_spec, 0);
-    // - Tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    GLuint attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-    glDrawBuffers(3, attachments);
+    GLint alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    draw_data_stride = (sizeof(DrawData) + alignment - 1) / alignment * alignment;
 
-    glGenRenderbuffers(1, &rbo_depth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo_depth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, g_screen_width, g_screen_height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo_depth);
+    glGenBuffers(1, &frame_UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, frame_UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frame_UBO);
 
-    // - Finally check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        THROW_EXCEPT(E_RENDER_ENGINE_ERROR, "Renderer::setup_gbuffer()", "cannot setup geometry buffer");
-    }
+    /* per-draw transforms, resized on demand and orphaned every frame */
+    glGenBuffers(1, &draw_UBO);
+    draw_UBO_size = 0;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Renderer::setup_instance_buffers()
+{
+    /* per-instance transforms and bone palettes are fetched from buffer textures */
+    glGenBuffers(1, &instance_TBO);
+    glBindBuffer(GL_TEXTURE_BUFFER, instance_TBO);
+    glBufferData(GL_TEXTURE_BUFFER, INSTANCE_TEXELS * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+    glGenTextures(1, &instance_texture);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, instance_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instance_TBO);
+
+    glGenBuffers(1, &bone_TBO);
+    glBindBuffer(GL_TEXTURE_BUFFER, bone_TBO);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    glGenTextures(1, &bone_texture);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, bone_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bone_TBO);
+
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texture_buffer_texels);
+}
+
+void Renderer::setup_clusters()
+{
+    /* light list, only uploaded when lights are added */
+    glGenBuffers(1, &light_TBO);
+    glBindBuffer(GL_TEXTURE_BUFFER, light_TBO);
+    glBufferData(GL_TEXTURE_BUFFER, LIGHT_TEXELS * sizeof(glm::vec4), NULL, GL_STATIC_DRAW);
+    glGenTextures(1, &light_texture);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, light_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, light_TBO);
+    lights_dirty = true;
+
+    /* per-cluster (offset, count) pairs and the light index lists they point into, rebuilt every frame */
+    glGenBuffers(1, &cluster_TBO);
+    glBindBuffer(GL_TEXTURE_BUFFER, cluster_TBO);
+    glBufferData(GL_TEXTURE_BUFFER, 2 * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+    glGenTextures(1, &cluster_texture);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, cluster_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, cluster_TBO);
+
+    glGenBuffers(1, &light_index_TBO);
+    glBindBuffer(GL_TEXTURE_BUFFER, light_index_TBO);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint), NULL, GL_STREAM_DRAW);
+    glGenTextures(1, &light_index_texture);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, light_index_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, light_index_TBO);
+
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    cluster_scale = CLUSTER_SLICES / log(Z_FAR / Z_NEAR);
 }
 
 void Renderer::setup_SSAO()
@@ -154,12 +237,17 @@ void Renderer::setup_SSAO()
     // Sample kernel
     std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0); // generates random floats between 0.0 and 1.0
     std::default_random_engine generator;
-    for (GLuint i = 0; i < 64; ++i)
+    for (GLuint i = 0; i < SSAO_KERNEL_SIZE; ++i)
     {
         glm::vec3 sample(randomFloats(generator) * 2.0 - 1.0, randomFloats(generator) * 2.0 - 1.0, randomFloats(generator));
         sample = glm::normalize(sample);
         sample *= randomFloats(generator);
-        GLfloat scale = GLfloat(i) / 64.0;
+        /* distances in bit reversed order, so that the first 8/16/32 samples still cover the whole hemisphere */
+        GLuint reversed = 0;
+        for (GLuint bit = 1; bit < SSAO_KERNEL_SIZE; bit <<= 1) {
+            reversed = (reversed << 1) | ((i & bit) ? 1 : 0);
+        }
+        GLfloat scale = GLfloat(reversed) / SSAO_KERNEL_SIZE;
 #define lerp(a, b, t) (t * b + (1 - (t)) * a)
         // Scale samples s.t. they're more aligned to center of kernel
         scale = lerp(0.1f, 1.0f, scale * scale);
@@ -167,6 +255,17 @@ void Renderer::setup_SSAO()
         ssao_kernel.push_back(sample);
     }
 
+    /* the kernel never changes, upload it once */
+    SSAOKernelBlock kernel_block;
+    for (GLuint i = 0; i < SSAO_KERNEL_SIZE; i++) {
+        kernel_block.samples[i] = glm::vec4(ssao_kernel[i], 0.0f);
+    }
+    glGenBuffers(1, &ssao_kernel_UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, ssao_kernel_UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(SSAOKernelBlock), &kernel_block, GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SSAO_KERNEL_BINDING, ssao_kernel_UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
     // Noise texture
     std::vector<glm::vec3> ssaoNoise;
     for (GLuint i = 0; i < 16; i++)
@@ -175,110 +274,58 @@ void Renderer::setup_SSAO()
         ssaoNoise.push_back(noise);
     }
     glGenTextures(1, &ssao_noise_texture);
-    glBindTexture(GL_TEXTURE_2D, ssao_noise_texture);
+    gl_state.bind_texture(GL_TEXTURE_2D, ssao_noise_texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 4, 4, 0, GL_RGB, GL_FLOAT, &ssaoNoise[0]);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    glGenFramebuffers(1, &ssao_fbo);
-    glGenFramebuffers(1, &ssao_blur_fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, ssao_fbo);
-    // - SSAO color buffer
-    glGenTextures(1, &ssao_color_buffer);
-    glBindTexture(GL_TEXTURE_2D, ssao_color_buffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, g_screen_width, g_screen_height, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssao_color_buffer, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        THROW_EXCEPT(E_RENDER_ENGINE_ERROR, "Renderer::setup_SSAO()", "cannot setup SSAO buffer");
-    // - and blur stage
-    glBindFramebuffer(GL_FRAMEBUFFER, ssao_blur_fbo);
-    glGenTextures(1, &ssao_color_buffer_blur);
-    glBindTexture(GL_TEXTURE_2D, ssao_color_buffer_blur);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, g_screen_width, g_screen_height, 0, GL_RGB, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssao_color_buffer_blur, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        THROW_EXCEPT(E_RENDER_ENGINE_ERROR, "Renderer::setup_SSAO()", "cannot setup SSAO blur buffer");
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Renderer::setup_shadow_map()
 {
-    glGenFramebuffers(1, &depth_map_fbo);
-    // Create depth cubemap texture
-    glGenTextures(1, &depth_cubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depth_cubemap);
-    for (GLuint i = 0; i < 6; ++i)
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    // Attach cubemap as depth map FBO's color buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, depth_map_fbo);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth_cubemap, 0);
+    /* dynamic casters are drawn over a copy of the static depth every frame */
+    shadow_atlas_size = glm::ivec2(g_shadow_atlas_size, g_shadow_atlas_size / 2);
+    glGenFramebuffers(1, &shadow_atlas_fbo);
+    shadow_atlas = create_shadow_atlas(shadow_atlas_fbo);
+    glGenFramebuffers(1, &static_shadow_atlas_fbo);
+    static_shadow_atlas = create_shadow_atlas(static_shadow_atlas_fbo);
+    shadow_map = static_shadow_atlas;
+    shadow_atlas_height = 0;
+
+    glGenBuffers(1, &shadow_UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, shadow_UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_DATA_BINDING, shadow_UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+GLuint Renderer::create_shadow_atlas(GLuint fbo)
+{
+    GLuint atlas;
+    glGenTextures(1, &atlas);
+    gl_state.bind_texture(GL_TEXTURE_2D, atlas);
+    /* the depth shader writes linear distance / far plane, 16 bits are plenty */
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, shadow_atlas_size.x, shadow_atlas_size.y, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlas, 0);
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         THROW_EXCEPT(E_RENDER_ENGINE_ERROR, "Renderer::setup_shadow_map()", "cannot setup shadow map buffer");
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
-
-void Renderer::setup_HDR()
-{
-	glGenFramebuffers(1, &hdr_fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, hdr_fbo);
-	glGenTextures(2, hdr_buffers);
-	for (GLuint i = 0; i < 2; i++)
-	{
-		glBindTexture(GL_TEXTURE_2D, hdr_buffers[i]);
-		glTexImage2D(
-			GL_TEXTURE_2D, 0, GL_RGB16F, g_screen_width, g_screen_height, 0, GL_RGB, GL_FLOAT, NULL
-			);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		// attach texture to framebuffer
-		glFramebufferTexture2D(
-			GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, hdr_buffers[i], 0
-			);
-	}
-	GLuint attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-	glDrawBuffers(2, attachments);
-
-	GLuint rbo_depth;
-    glGenRenderbuffers(1, &rbo_depth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo_depth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, g_screen_width, g_screen_height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo_depth);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	glGenFramebuffers(2, bloom_blur_fbo);
-	glGenTextures(2, bloom_blur_buffers);
-	for (GLuint i = 0; i < 2; i++)
-	{
-		glBindFramebuffer(GL_FRAMEBUFFER, bloom_blur_fbo[i]);
-		glBindTexture(GL_TEXTURE_2D, bloom_blur_buffers[i]);
-		glTexImage2D(
-			GL_TEXTURE_2D, 0, GL_RGB16F, g_screen_width, g_screen_height, 0, GL_RGB, GL_FLOAT, NULL
-			);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glFramebufferTexture2D(
-			GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloom_blur_buffers[i], 0
-			);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	}
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+
+    return atlas;
+}
+
+void Renderer::invalidate_shadow_cache()
+{
+    shadow_cache.clear();
 }
 
 void Renderer::set_viewport(int width, int height)
@@ -324,49 +371,274 @@ void Renderer::uniform(ShaderProgram::UniformID id, GLsizei count, GLboolean tra
     current_shader->uniform(id, count, transpose, mat);
 }
 
-void Renderer::update_mvp()
+void Renderer::upload_frame_data()
 {
-    glm::mat4 mvp = projection * view * model;
+    FrameData data;
+    data.view = view;
+    data.projection = projection;
+    data.inv_view = glm::inverse(view);
+    data.inv_projection = glm::inverse(projection);
+    data.view_pos = glm::vec4(view_pos, 1.0f);
+    data.cluster_params = glm::vec4((float) CLUSTER_TILE_SIZE, cluster_scale, -log(Z_NEAR) * cluster_scale, 0.0f);
+    data.cluster_dims = cluster_dims;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, frame_UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
 
-    for (auto it : shaders) {
-        it.second->uniform(ShaderProgram::MVP, 1, false, glm::value_ptr(mvp));
-        it.second->uniform(ShaderProgram::MODEL, 1, false, glm::value_ptr(model));
+void Renderer::upload_draw_data()
+{
+    size_t num_commands = command_queue.get_num_commands();
+    if (!num_commands) return;
+
+    /* instances are laid out in command order so that every batch is a contiguous range */
+    instance_data.resize(num_commands * INSTANCE_TEXELS);
+    for (size_t i = 0; i < num_commands; i++) {
+        const RenderQueue::DrawItem& draw = command_queue.get_draw(i);
+        glm::vec4* instance = &instance_data[i * INSTANCE_TEXELS];
+        for (int j = 0; j < 4; j++) {
+            instance[j] = draw.model[j];
+        }
+        instance[4] = glm::vec4((float) draw.bone_offset, 0.0f, 0.0f, 0.0f);
     }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, instance_TBO);
+    glBufferData(GL_TEXTURE_BUFFER, instance_data.size() * sizeof(glm::vec4), &instance_data[0], GL_STREAM_DRAW);
+    /* a palette beyond the limit is not addressable by the shaders */
+    if (command_queue.get_num_bones() * 4 > (size_t)max_texture_buffer_texels) {
+        LOG.warn("RENDERER::bone palette of %d transforms exceeds the texture buffer limit", (int)command_queue.get_num_bones());
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, bone_TBO);
+    glBufferData(GL_TEXTURE_BUFFER, command_queue.get_num_bones() * sizeof(glm::mat4), command_queue.get_bones(0), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    size_t num_batches = command_queue.get_num_batches();
+    GLsizeiptr size = num_batches * draw_data_stride;
+    draw_data.resize(size);
+
+    for (size_t i = 0; i < num_batches; i++) {
+        DrawData* data = reinterpret_cast<DrawData*>(&draw_data[i * draw_data_stride]);
+        data->instance = glm::ivec4(command_queue.get_batch(i).first, 0, 0, 0);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, draw_UBO);
+    if (size > draw_UBO_size) {
+        draw_UBO_size = size;
+    }
+    /* orphan the storage of the last frame */
+    glBufferData(GL_UNIFORM_BUFFER, draw_UBO_size, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, &draw_data[0]);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void Renderer::begin_frame()
 {
     render_queue.clear();
     overlay_queue.clear();
+    stream_buffer.begin_frame();
+    gl_state.begin_frame();
 }
 
 void Renderer::end_frame()
 {
-    model = xforms.top();
+    build_clusters();
+    upload_frame_data();
+    record_commands();
+    upload_draw_data();
 
+    gpu_profiler.begin_frame();
+    gpu_profiler.begin("shadow");
     shadow_map_pass();
+    gpu_profiler.end();
 
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glBindFramebuffer(GL_FRAMEBUFFER, gbuffer);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    use_shader(GEOMETRY_PASS_SHADER);
-    update_mvp();
+    build_frame_graph();
+    frame_graph.compile();
+    frame_graph.execute(&gpu_profiler);
+    stream_buffer.end_frame();
 
-    for (int i = 0; i < render_queue.size(); i++) {
-		if (!render_queue[i]->is_opaque()) continue;
-        render_queue[i]->draw(*this);
-    }
+    while (xforms.size() > 1) xforms.pop();
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void Renderer::end_static_frame(bool redraw)
+{
+    if (redraw || !overlay_cache_valid) {
+        gl_state.bind_framebuffer(GL_FRAMEBUFFER, overlay_cache_fbo);
+        glViewport(0, 0, g_screen_width, g_screen_height);
+        glClear(GL_COLOR_BUFFER_BIT);
+        overlay_pass();
+        overlay_cache_valid = true;
+    }
 
-    SSAO_pass();
-    render_lighting_pass();
-	post_process_pass();
-    overlay_pass();
+    /* the back buffer may be multisampled, so the cache is drawn instead of blitted */
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, g_screen_width, g_screen_height);
+    gl_state.disable(GL_DEPTH_TEST);
+    use_shader(SCREEN_COPY_SHADER);
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, overlay_cache_texture);
+    render_quad();
+    gl_state.bind_texture(GL_TEXTURE_2D, 0);
+    gl_state.enable(GL_DEPTH_TEST);
+    stream_buffer.end_frame();
 
     while (xforms.size() > 1) xforms.pop();
 }
 
+void Renderer::build_frame_graph()
+{
+    typedef FrameGraph::Resource Resource;
+    typedef FrameGraph::TextureDesc TextureDesc;
+    typedef FrameGraph::PassBuilder PassBuilder;
+
+    frame_graph.reset(g_screen_width, g_screen_height);
+
+    /* the shadow atlas is cached across frames and lives outside of the graph */
+    Resource shadow = frame_graph.import_texture("shadow_atlas", shadow_map,
+                                                 TextureDesc(shadow_atlas_size.x, shadow_atlas_size.y, GL_DEPTH_COMPONENT16));
+
+    Resource depth, normal, albedo_spec;
+    frame_graph.add_pass("geometry", [&](PassBuilder& builder) {
+        normal = builder.create("g_normal", TextureDesc(g_screen_width, g_screen_height, GL_RG16));
+        albedo_spec = builder.create("g_albedo_spec", TextureDesc(g_screen_width, g_screen_height, GL_RGBA8));
+        depth = builder.create("g_depth", TextureDesc(g_screen_width, g_screen_height, GL_DEPTH_COMPONENT24));
+    }, [this](const FrameGraph& graph) {
+        geometry_pass();
+    });
+
+    Resource ssao;
+    int ssao_width = glm::max(g_screen_width / g_ssao_scale, 1);
+    int ssao_height = glm::max(g_screen_height / g_ssao_scale, 1);
+    frame_graph.add_pass("SSAO", [&](PassBuilder& builder) {
+        builder.read(depth);
+        builder.read(normal);
+        /* occlusion and view depth for the bilateral upsample */
+        ssao = builder.create("SSAO", TextureDesc(ssao_width, ssao_height, GL_RG16F));
+    }, [=](const FrameGraph& graph) {
+        SSAO_pass(graph.get_texture(depth), graph.get_texture(normal));
+    });
+
+    Resource ssao_full;
+    frame_graph.add_pass("SSAO_upsample", [&](PassBuilder& builder) {
+        builder.read(ssao);
+        builder.read(depth);
+        builder.read(normal);
+        ssao_full = builder.create("SSAO_full", TextureDesc(g_screen_width, g_screen_height, GL_R8));
+    }, [=](const FrameGraph& graph) {
+        SSAO_upsample_pass(graph.get_texture(ssao), graph.get_texture(depth), graph.get_texture(normal));
+    });
+
+    Resource hdr_color, hdr_bright;
+    frame_graph.add_pass("lighting", [&](PassBuilder& builder) {
+        builder.read(depth);
+        builder.read(normal);
+        builder.read(albedo_spec);
+        builder.read(ssao_full);
+        builder.read(shadow);
+        hdr_color = builder.create("HDR_color", TextureDesc(g_screen_width, g_screen_height, GL_RGB16F, GL_LINEAR));
+        hdr_bright = builder.create("HDR_bright", TextureDesc(g_screen_width, g_screen_height, GL_RGB16F, GL_LINEAR));
+    }, [=](const FrameGraph& graph) {
+        render_lighting_pass(graph.get_texture(depth), graph.get_texture(normal),
+                             graph.get_texture(albedo_spec), graph.get_texture(ssao_full));
+    });
+
+    /* depth tested against the geometry buffer depth, attached directly instead of blitted */
+    frame_graph.add_pass("forward", [&](PassBuilder& builder) {
+        builder.write(hdr_color);
+        builder.write(hdr_bright);
+        builder.write(depth);
+    }, [this](const FrameGraph& graph) {
+        forward_pass();
+    });
+
+    Resource bloom = -1;
+    int bloom_levels = 0;
+    if (g_bloom) bloom = add_bloom_passes(hdr_bright, bloom_levels);
+
+    frame_graph.add_pass("composite", [&](PassBuilder& builder) {
+        builder.read(hdr_color);
+        if (bloom != -1) builder.read(bloom);
+        builder.side_effect();
+    }, [=](const FrameGraph& graph) {
+        post_process_pass(graph.get_texture(hdr_color), bloom != -1 ? graph.get_texture(bloom) : 0, bloom_levels);
+    });
+
+    frame_graph.add_pass("overlay", [](PassBuilder& builder) {
+        builder.side_effect();
+    }, [this](const FrameGraph& graph) {
+        overlay_pass();
+    });
+}
+
+FrameGraph::Resource Renderer::add_bloom_passes(FrameGraph::Resource bright, int& num_levels)
+{
+    typedef FrameGraph::Resource Resource;
+    typedef FrameGraph::TextureDesc TextureDesc;
+    typedef FrameGraph::PassBuilder PassBuilder;
+
+    /* progressive downsample, each level half the size of the previous one starting at half resolution */
+    std::vector<Resource> levels;
+    Resource input = bright;
+    glm::ivec2 size(g_screen_width, g_screen_height);
+    for (int i = 0; i < g_bloom_mips; i++) {
+        glm::ivec2 input_size = size;
+        size = glm::max(size / 2, glm::ivec2(1));
+        if (i > 0 && size == input_size) break;
+
+        Resource level;
+        frame_graph.add_pass("bloom_downsample", [&](PassBuilder& builder) {
+            builder.read(input);
+            level = builder.create("bloom_level", TextureDesc(size.x, size.y, GL_R11F_G11F_B10F, GL_LINEAR));
+        }, [=](const FrameGraph& graph) {
+            bloom_downsample_pass(graph.get_texture(input), input_size, i == 0);
+        });
+
+        levels.push_back(level);
+        input = level;
+    }
+
+    /* widen the glow further with separable blurs on the smallest level, which are almost free */
+    Resource last = levels.back();
+    for (int i = 0; i < g_bloom_iterations; i++) {
+        Resource scratch;
+        frame_graph.add_pass("bloom_blur", [&](PassBuilder& builder) {
+            builder.read(last);
+            scratch = builder.create("bloom_scratch", frame_graph.get_desc(last));
+        }, [=](const FrameGraph& graph) {
+            gaussian_blur_pass(graph.get_texture(last), true);
+        });
+        frame_graph.add_pass("bloom_blur", [&](PassBuilder& builder) {
+            builder.read(scratch);
+            builder.write(last);
+        }, [=](const FrameGraph& graph) {
+            gaussian_blur_pass(graph.get_texture(scratch), false);
+        });
+    }
+
+    /* upsample back with a tent filter, accumulating onto each larger level */
+    for (size_t i = levels.size() - 1; i > 0; i--) {
+        Resource src = levels[i];
+        frame_graph.add_pass("bloom_upsample", [&](PassBuilder& builder) {
+            builder.read(src);
+            builder.write(levels[i - 1]);
+        }, [=](const FrameGraph& graph) {
+            const TextureDesc& desc = graph.get_desc(src);
+            bloom_upsample_pass(graph.get_texture(src), glm::ivec2(desc.width, desc.height));
+        });
+    }
+
+    num_levels = levels.size();
+    return levels[0];
+}
+
+void Renderer::geometry_pass()
+{
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    use_shader(GEOMETRY_PASS_SHADER);
+    replay_commands(RenderQueue::GEOMETRY_PASS);
+}
+
 void Renderer::push_matrix()
 {
     xforms.push(model);
@@ -376,13 +648,284 @@ void Renderer::pop_matrix()
 {
     model = xforms.top();
     xforms.pop();
-    update_mvp();
 }
 
 void Renderer::add_light(const glm::vec3& position, const glm::vec3& color, float linear, float quadratic)
 {
-    if (lights.size() >= MAX_LIGHTS) return;
-    lights.push_back(Light(position, color, linear, quadratic));
+    if (lights.size() >= MAX_LIGHTS) {
+        LOG.warn("RENDERER::too many lights, dropping light at (%f, %f, %f)", position.x, position.y, position.z);
+        return;
+    }
+
+    /* solve intensity / (1 + linear * d + quadratic * d^2) = LIGHT_CUTOFF for d */
+    float intensity = glm::max(color.x, glm::max(color.y, color.z));
+    if (intensity < LIGHT_CUTOFF) {
+        LOG.warn("RENDERER::light at (%f, %f, %f) is below the cutoff, dropping it", position.x, position.y, position.z);
+        return;
+    }
+
+    Light light(position, color, linear, quadratic);
+    float c = 1.0f - intensity / LIGHT_CUTOFF;
+    if (quadratic > 0.0f) {
+        float discriminant = glm::max(linear * linear - 4.0f * quadratic * c, 0.0f);
+        light.radius = glm::max((-linear + sqrt(discriminant)) / (2.0f * quadratic), 0.0f);
+    } else if (linear > 0.0f) {
+        light.radius = -c / linear;
+    } else {
+        light.radius = Z_FAR;
+    }
+
+    lights.push_back(light);
+    lights_dirty = true;
+    invalidate_shadow_cache();
+}
+
+void Renderer::upload_lights()
+{
+    std::vector<glm::vec4> light_data(lights.size() * LIGHT_TEXELS);
+    for (size_t i = 0; i < lights.size(); i++) {
+        glm::vec4* data = &light_data[i * LIGHT_TEXELS];
+        data[0] = glm::vec4(lights[i].position, lights[i].radius);
+        data[1] = glm::vec4(lights[i].color, 1.0f);
+        /* spread the flicker of the lights so that they do not pulse in sync */
+        float phase = (float) i * 0.618034f;
+        phase -= (int) phase;
+        data[2] = glm::vec4(lights[i].linear, lights[i].quadratic, phase, 0.0f);
+    }
+
+    if (!light_data.empty()) {
+        glBindBuffer(GL_TEXTURE_BUFFER, light_TBO);
+        glBufferData(GL_TEXTURE_BUFFER, light_data.size() * sizeof(glm::vec4), &light_data[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    lights_dirty = false;
+}
+
+int Renderer::get_cluster_slice(float depth) const
+{
+    int slice = (int) (log(depth / Z_NEAR) * cluster_scale);
+    return glm::clamp(slice, 0, CLUSTER_SLICES - 1);
+}
+
+void Renderer::build_clusters()
+{
+    cluster_dims = glm::ivec4((g_screen_width + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE,
+                              (g_screen_height + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE,
+                              CLUSTER_SLICES, lights.size());
+    int num_clusters = cluster_dims.x * cluster_dims.y * cluster_dims.z;
+    cluster_grid.assign(2 * num_clusters, 0);
+
+    /* find the clusters touched by the bounding box of each light sphere */
+    cluster_ranges.clear();
+    for (size_t i = 0; i < lights.size(); i++) {
+        const Light& light = lights[i];
+        if (!view_frustum.intersects(light.position, light.radius)) continue;
+
+        glm::vec3 center(view * glm::vec4(light.position, 1.0f));
+        float depth = -center.z;
+        float near_depth = glm::max(depth - light.radius, Z_NEAR);
+        float far_depth = glm::min(depth + light.radius, Z_FAR);
+
+        ClusterRange range;
+        range.light = i;
+        range.min_z = get_cluster_slice(near_depth);
+        range.max_z = get_cluster_slice(far_depth);
+        range.min_x = range.min_y = 0;
+        range.max_x = cluster_dims.x - 1;
+        range.max_y = cluster_dims.y - 1;
+
+        /* spheres crossing the near plane cover the whole screen, otherwise x / depth is extremal at the box corners */
+        if (depth - light.radius > Z_NEAR) {
+            float min_ndc[2] = { 1.0f, 1.0f };
+            float max_ndc[2] = { -1.0f, -1.0f };
+            for (int sx = -1; sx <= 1; sx += 2) {
+                for (int sy = -1; sy <= 1; sy += 2) {
+                    for (float d : { near_depth, far_depth }) {
+                        float ndc_x = projection[0][0] * (center.x + sx * light.radius) / d;
+                        float ndc_y = projection[1][1] * (center.y + sy * light.radius) / d;
+                        min_ndc[0] = glm::min(min_ndc[0], ndc_x);
+                        max_ndc[0] = glm::max(max_ndc[0], ndc_x);
+                        min_ndc[1] = glm::min(min_ndc[1], ndc_y);
+                        max_ndc[1] = glm::max(max_ndc[1], ndc_y);
+                    }
+                }
+            }
+
+            auto to_tile = [](float ndc, int size, int tiles) {
+                int tile = (int) ((ndc * 0.5f + 0.5f) * size / CLUSTER_TILE_SIZE);
+                return glm::clamp(tile, 0, tiles - 1);
+            };
+            range.min_x = to_tile(min_ndc[0], g_screen_width, cluster_dims.x);
+            range.max_x = to_tile(max_ndc[0], g_screen_width, cluster_dims.x);
+            range.min_y = to_tile(min_ndc[1], g_screen_height, cluster_dims.y);
+            range.max_y = to_tile(max_ndc[1], g_screen_height, cluster_dims.y);
+        }
+
+        cluster_ranges.push_back(range);
+    }
+
+#define CLUSTER_INDEX(x, y, z) (((z) * cluster_dims.y + (y)) * cluster_dims.x + (x))
+    /* count, prefix sum, then fill the index lists */
+    for (auto& range : cluster_ranges) {
+        for (int z = range.min_z; z <= range.max_z; z++) {
+            for (int y = range.min_y; y <= range.max_y; y++) {
+                for (int x = range.min_x; x <= range.max_x; x++) {
+                    cluster_grid[2 * CLUSTER_INDEX(x, y, z) + 1]++;
+                }
+            }
+        }
+    }
+
+    GLuint offset = 0;
+    for (int i = 0; i < num_clusters; i++) {
+        cluster_grid[2 * i] = offset;
+        offset += cluster_grid[2 * i + 1];
+        cluster_grid[2 * i + 1] = 0;
+    }
+
+    light_indices.resize(glm::max((int) offset, 1));
+    for (auto& range : cluster_ranges) {
+        for (int z = range.min_z; z <= range.max_z; z++) {
+            for (int y = range.min_y; y <= range.max_y; y++) {
+                for (int x = range.min_x; x <= range.max_x; x++) {
+                    GLuint* cluster = &cluster_grid[2 * CLUSTER_INDEX(x, y, z)];
+                    light_indices[cluster[0] + cluster[1]++] = range.light;
+                }
+            }
+        }
+    }
+#undef CLUSTER_INDEX
+
+    glBindBuffer(GL_TEXTURE_BUFFER, cluster_TBO);
+    glBufferData(GL_TEXTURE_BUFFER, cluster_grid.size() * sizeof(GLuint), &cluster_grid[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, light_index_TBO);
+    glBufferData(GL_TEXTURE_BUFFER, light_indices.size() * sizeof(GLuint), &light_indices[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void Renderer::set_bone_transforms(GLsizei count, const GLfloat* transforms)
+{
+    bone_offset = command_queue.push_bones(count, transforms);
+}
+
+void Renderer::submit(GLuint vao, GLsizei index_count, Material* material, const AABB& bound)
+{
+    /* each pass only gets the meshes that can contribute to it */
+    AABB world_bound = bound.transform(model);
+    bool visible = is_visible(world_bound);
+    /* shadow atlas tiles (light slot * MAX_SHADOW_FACES + face) the mesh lands on */
+    int shadow_tiles[MAX_SHADOW_LIGHTS * MAX_SHADOW_FACES];
+    int num_shadow_tiles = 0;
+    for (size_t i = 0; i < shadow_slots.size(); i++) {
+        const ShadowSlot& slot = shadow_slots[i];
+        if (!world_bound.intersects(lights[slot.light].position, SHADOW_FAR)) continue;
+        for (int j = 0; j < num_shadow_faces; j++) {
+            if (slot.frustums[j].intersects(world_bound)) shadow_tiles[num_shadow_tiles++] = i * MAX_SHADOW_FACES + j;
+        }
+    }
+    if (!visible && !num_shadow_tiles) return;
+
+    RenderQueue::DrawItem draw;
+    draw.vao = vao;
+    draw.index_count = index_count;
+    draw.material = material;
+    draw.model = model;
+    draw.bone_offset = bone_offset;
+    uint32_t draw_index = command_queue.push_draw(draw);
+
+    /* front to back within the same state */
+    glm::vec4 view_space = view * glm::vec4(world_bound.get_center(), 1.0f);
+    float depth = (-view_space.z - Z_NEAR) / (Z_FAR - Z_NEAR);
+    int material_id = material ? material->get_id() : 0;
+
+    /* material does not matter for the depth only shadow pass, one command per tile with the tile in its place */
+    RenderQueue::Pass shadow_pass = submit_static ? RenderQueue::STATIC_SHADOW_PASS : RenderQueue::SHADOW_PASS;
+    for (int i = 0; i < num_shadow_tiles; i++) {
+        command_queue.push_command(RenderQueue::make_key(shadow_pass, shaders[DEPTH_MAP_SHADER]->get_program(),
+                                                         shadow_tiles[i], vao, depth), draw_index);
+    }
+    if (visible) {
+        command_queue.push_command(RenderQueue::make_key(RenderQueue::GEOMETRY_PASS, shaders[GEOMETRY_PASS_SHADER]->get_program(),
+                                                         material_id, vao, depth), draw_index);
+    }
+}
+
+bool Renderer::is_visible(const AABB& bound) const
+{
+    return view_frustum.intersects(bound);
+}
+
+bool Renderer::casts_shadow(const AABB& bound) const
+{
+    /* anything within the far plane of a shadow light may show up in its faces */
+    for (auto& slot : shadow_slots) {
+        if (bound.intersects(lights[slot.light].position, SHADOW_FAR)) return true;
+    }
+    return false;
+}
+
+void Renderer::record_commands()
+{
+    static std::vector<glm::mat4> identity_transforms(ShaderProgram::MAX_BONE_TRANSFORMS);
+
+    model = xforms.top();
+    command_queue.clear();
+    set_bone_transforms(ShaderProgram::MAX_BONE_TRANSFORMS, glm::value_ptr(identity_transforms[0]));
+
+    for (int i = 0; i < render_queue.size(); i++) {
+        if (!render_queue[i]->is_opaque()) continue;
+        submit_static = render_queue[i]->is_static();
+        render_queue[i]->draw(*this);
+    }
+    submit_static = false;
+
+    command_queue.sort();
+}
+
+void Renderer::replay_commands(RenderQueue::Pass pass)
+{
+    size_t begin, end;
+    command_queue.get_pass_batches(pass, begin, end);
+    replay_batches(pass, begin, end);
+}
+
+void Renderer::replay_batches(RenderQueue::Pass pass, size_t begin, size_t end)
+{
+    gl_state.active_texture(INSTANCE_DATA_TARGET);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, instance_texture);
+    gl_state.active_texture(BONE_PALETTE_TARGET);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, bone_texture);
+
+    GLuint cur_vao = 0;
+    Material* cur_material = nullptr;
+
+    for (size_t i = begin; i < end; i++) {
+        const RenderQueue::Batch& batch = command_queue.get_batch(i);
+        const RenderQueue::DrawItem& draw = command_queue.get_draw(batch.first);
+
+        glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_DATA_BINDING, draw_UBO, i * draw_data_stride, sizeof(DrawData));
+
+        /* the depth only pass does not sample materials */
+        if (pass == RenderQueue::GEOMETRY_PASS && draw.material && draw.material != cur_material) {
+            bind_material(draw.material);
+            cur_material = draw.material;
+        }
+
+        if (draw.vao != cur_vao) {
+            gl_state.bind_vertex_array(draw.vao);
+            cur_vao = draw.vao;
+        }
+        glDrawElementsInstanced(GL_TRIANGLES, draw.index_count, GL_UNSIGNED_INT, 0, batch.count);
+    }
+}
+
+void Renderer::bind_material(Material* material)
+{
+    material->get_diffuse_texture()->bind(DIFFUSE_TEXTURE_TARGET);
+    material->get_normal_map()->bind(NORMAL_MAP_TARGET);
+    uniform(ShaderProgram::MAT_METALLIC, material->get_metallic());
+    uniform(ShaderProgram::MAT_ROUGHNESS, material->get_roughness());
 }
 
 void Renderer::enqueue_renderable(PRenderable renderable)
@@ -398,19 +941,175 @@ void Renderer::enqueue_overlay(POverlay overlay)
 void Renderer::update_camera(const Camera& camera)
 {
     view_pos = camera.get_position();
-    int min_index = 0;
-    float min_dist = glm::distance(view_pos, lights[0].position);
-    for (int i = 1; i < lights.size(); i++) {
-        float dist = glm::distance(view_pos, lights[i].position);
-        if (dist < min_dist) {
-            min_dist = dist;
-            min_index = i;
+    view = camera.get_view_matrix();
+    view_frustum = Frustum(projection * view);
+
+    select_shadow_lights();
+}
+
+void Renderer::select_shadow_lights()
+{
+    /* rank the lights in view by the approximate size of their lit region on screen */
+    shadow_candidates.clear();
+    float pixels_per_unit = g_screen_height / (2.0f * tan(FOV * 0.5f));
+    for (size_t i = 0; i < lights.size(); i++) {
+        float radius = glm::min(lights[i].radius, SHADOW_FAR);
+        if (!view_frustum.intersects(lights[i].position, radius)) continue;
+
+        float dist = glm::max(glm::distance(view_pos, lights[i].position), Z_NEAR);
+        ShadowCandidate candidate;
+        candidate.light = i;
+        candidate.coverage = radius / dist * pixels_per_unit;
+        shadow_candidates.push_back(candidate);
+    }
+    std::sort(shadow_candidates.begin(), shadow_candidates.end(),
+              [](const ShadowCandidate& a, const ShadowCandidate& b) { return a.coverage > b.coverage; });
+
+    int max_lights = glm::clamp(g_shadow_lights, 0, MAX_SHADOW_LIGHTS);
+    if (shadow_candidates.size() > (size_t)max_lights) shadow_candidates.resize(max_lights);
+
+    /* face resolution follows the coverage, rounded down to a power of two, the six faces of the
+     * largest light fill two rows of the atlas */
+    int max_face_size = glm::min(MAX_SHADOW_FACE_SIZE, shadow_atlas_size.x / 4);
+    shadow_slots.resize(shadow_candidates.size());
+    for (size_t i = 0; i < shadow_candidates.size(); i++) {
+        int face_size = MIN_SHADOW_FACE_SIZE;
+        while (face_size * 2 <= shadow_candidates[i].coverage && face_size * 2 <= max_face_size) {
+            face_size *= 2;
         }
+        shadow_slots[i].light = shadow_candidates[i].light;
+        shadow_slots[i].face_size = face_size;
     }
-    shadow_map_light_index = min_index;
 
-    view = camera.get_view_matrix();
-    update_mvp();
+    /* over budget, halve the largest faces until everything fits, then drop the least relevant lights */
+    while (!pack_shadow_atlas()) {
+        int largest = shadow_slots[0].face_size;
+        if (largest <= MIN_SHADOW_FACE_SIZE) {
+            shadow_slots.pop_back();
+            continue;
+        }
+        for (auto& slot : shadow_slots) {
+            if (slot.face_size == largest) slot.face_size /= 2;
+        }
+    }
+
+    for (auto& slot : shadow_slots) {
+        update_shadow_transforms(slot);
+        slot.cached = is_shadow_cached(slot);
+    }
+}
+
+bool Renderer::pack_shadow_atlas()
+{
+    /* power of two squares in decreasing size fill the shelves without gaps */
+    std::stable_sort(shadow_slots.begin(), shadow_slots.end(),
+                     [](const ShadowSlot& a, const ShadowSlot& b) { return a.face_size > b.face_size; });
+
+    int x = 0, y = 0, row_height = 0;
+    for (auto& slot : shadow_slots) {
+        for (int i = 0; i < num_shadow_faces; i++) {
+            if (x + slot.face_size > shadow_atlas_size.x) {
+                x = 0;
+                y += row_height;
+                row_height = 0;
+            }
+            if (y + slot.face_size > shadow_atlas_size.y) return false;
+
+            slot.face_offsets[i] = glm::ivec2(x, y);
+            x += slot.face_size;
+            row_height = glm::max(row_height, slot.face_size);
+        }
+    }
+
+    shadow_atlas_height = y + row_height;
+    return true;
+}
+
+void Renderer::update_shadow_transforms(ShadowSlot& slot)
+{
+    glm::vec3 lightPos = lights[slot.light].position;
+
+    if (g_shadow_technique == ShadowTechnique::DUAL_PARABOLOID) {
+        /* light views looking down and up, the depth shader warps each hemisphere onto its paraboloid */
+        slot.transforms[0] = glm::lookAt(lightPos, lightPos + glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, 1.0));
+        slot.transforms[1] = glm::lookAt(lightPos, lightPos + glm::vec3(0.0,  1.0, 0.0), glm::vec3(0.0, 0.0, -1.0));
+        slot.frustums[0] = Frustum(glm::vec4(0.0f, -1.0f, 0.0f, lightPos.y));
+        slot.frustums[1] = Frustum(glm::vec4(0.0f, 1.0f, 0.0f, -lightPos.y));
+        return;
+    }
+
+    glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR, SHADOW_FAR);
+    slot.transforms[0] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 1.0,  0.0,  0.0), glm::vec3(0.0, -1.0,  0.0));
+    slot.transforms[1] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0,  0.0,  0.0), glm::vec3(0.0, -1.0,  0.0));
+    slot.transforms[2] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,  1.0,  0.0), glm::vec3(0.0,  0.0,  1.0));
+    slot.transforms[3] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0, -1.0,  0.0), glm::vec3(0.0,  0.0, -1.0));
+    slot.transforms[4] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,  0.0,  1.0), glm::vec3(0.0, -1.0,  0.0));
+    slot.transforms[5] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,  0.0, -1.0), glm::vec3(0.0, -1.0,  0.0));
+
+    for (int i = 0; i < 6; i++) {
+        slot.frustums[i] = Frustum(slot.transforms[i]);
+    }
+}
+
+bool Renderer::is_shadow_cached(const ShadowSlot& slot) const
+{
+    for (auto& entry : shadow_cache) {
+        if (entry.light != slot.light || entry.face_size != slot.face_size) continue;
+
+        bool same_tiles = true;
+        for (int i = 0; i < num_shadow_faces; i++) {
+            if (entry.face_offsets[i] != slot.face_offsets[i]) same_tiles = false;
+        }
+        if (same_tiles) return true;
+    }
+    return false;
+}
+
+void Renderer::cache_shadow_slot(const ShadowSlot& slot)
+{
+    auto overlaps = [](const glm::ivec2& a, int a_size, const glm::ivec2& b, int b_size) {
+        return a.x < b.x + b_size && b.x < a.x + a_size && a.y < b.y + b_size && b.y < a.y + a_size;
+    };
+
+    /* the tiles of the slot have been overwritten, forget whatever lived there */
+    auto it = shadow_cache.begin();
+    while (it != shadow_cache.end()) {
+        bool overwritten = it->light == slot.light;
+        for (int i = 0; i < num_shadow_faces && !overwritten; i++) {
+            for (int j = 0; j < num_shadow_faces && !overwritten; j++) {
+                overwritten = overlaps(it->face_offsets[i], it->face_size, slot.face_offsets[j], slot.face_size);
+            }
+        }
+        if (overwritten) {
+            it = shadow_cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    shadow_cache.push_back(slot);
+}
+
+void Renderer::upload_shadow_data()
+{
+    ShadowBlock block;
+    block.num_shadows = glm::ivec4(shadow_slots.size(), shadow_atlas_size.x, (int) g_shadow_technique, shadow_atlas_size.y);
+    for (size_t i = 0; i < shadow_slots.size(); i++) {
+        const ShadowSlot& slot = shadow_slots[i];
+        ShadowData& data = block.shadows[i];
+        data.light = glm::ivec4(slot.light, 0, 0, 0);
+
+        glm::vec2 scale(1.0f / shadow_atlas_size.x, 1.0f / shadow_atlas_size.y);
+        for (int j = 0; j < num_shadow_faces; j++) {
+            data.rects[j] = glm::vec4(slot.face_offsets[j].x * scale.x, slot.face_offsets[j].y * scale.y,
+                                      slot.face_size * scale.x, slot.face_size * scale.y);
+            data.transforms[j] = slot.transforms[j];
+        }
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, shadow_UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::ivec4) + shadow_slots.size() * sizeof(ShadowData), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void Renderer::setup_quad()
@@ -425,7 +1124,7 @@ void Renderer::setup_quad()
     // Setup plane VAO
     glGenVertexArrays(1, &quad_VAO);
     glGenBuffers(1, &quad_VBO);
-    glBindVertexArray(quad_VAO);
+    gl_state.bind_vertex_array(quad_VAO);
     glBindBuffer(GL_ARRAY_BUFFER, quad_VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -436,194 +1135,377 @@ void Renderer::setup_quad()
 
 void Renderer::render_quad()
 {
-    glBindVertexArray(quad_VAO);
+    gl_state.bind_vertex_array(quad_VAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
 
-void Renderer::render_lighting_pass()
-{   
+void Renderer::render_lighting_pass(GLuint depth, GLuint normal, GLuint albedo_spec, GLuint ssao)
+{
     use_shader(LIGHTING_PASS_SHADER);
-	glBindFramebuffer(GL_FRAMEBUFFER, hdr_fbo);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	update_mvp();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, g_position);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, g_normal);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, g_albedo_spec);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, ssao_color_buffer_blur);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depth_cubemap);
-    glm::vec3 shadow_light_pos = lights[shadow_map_light_index].position;
-    uniform("uShadowLightPos", shadow_light_pos.x, shadow_light_pos.y, shadow_light_pos.z);
-    uniform("uShadowLightIndex", shadow_map_light_index);
-
-    GLuint lighting_program = shaders[LIGHTING_PASS_SHADER]->get_program();
-    for (GLuint i = 0; i < lights.size(); i++)
-    {
-		glUniform3fv(glGetUniformLocation(lighting_program, ("uLights[" + std::to_string(i) + "].position").c_str()), 1, &lights[i].position[0]);
-        if (0) {
-            glm::vec3 red = glm::vec3(1.0f, 0.0f, 0.0f);
-            glUniform3fv(glGetUniformLocation(lighting_program, ("uLights[" + std::to_string(i) + "].color").c_str()),
-                         1, &red[0]);
-        } else {
-            glUniform3fv(glGetUniformLocation(lighting_program, ("uLights[" + std::to_string(i) + "].color").c_str()),
-                         1, &lights[i].color[0]);
-        }
-        // Update attenuation parameters and calculate radius
-        glUniform1f(glGetUniformLocation(lighting_program, ("uLights[" + std::to_string(i) + "].linear").c_str()), lights[i].linear);
-        glUniform1f(glGetUniformLocation(lighting_program, ("uLights[" + std::to_string(i) + "].quadratic").c_str()), lights[i].quadratic);
-
-        float intensity = RandomUtils::random_int(900, 1000) / 1000.0;
-        glUniform1f(glGetUniformLocation(lighting_program, ("uLights[" + std::to_string(i) + "].intensity").c_str()), intensity);
-    }
-    uniform(ShaderProgram::VIEW_POS, view_pos.x, view_pos.y, view_pos.z);
+    glClear(GL_COLOR_BUFFER_BIT);
 
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, depth);
+    gl_state.active_texture(GL_TEXTURE1);
+    gl_state.bind_texture(GL_TEXTURE_2D, normal);
+    gl_state.active_texture(GL_TEXTURE2);
+    gl_state.bind_texture(GL_TEXTURE_2D, albedo_spec);
+    gl_state.active_texture(GL_TEXTURE3);
+    gl_state.bind_texture(GL_TEXTURE_2D, ssao);
+    gl_state.active_texture(GL_TEXTURE4);
+    gl_state.bind_texture(GL_TEXTURE_2D, shadow_map);
+
+    if (lights_dirty) upload_lights();
+    gl_state.active_texture(LIGHT_DATA_TARGET);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, light_texture);
+    gl_state.active_texture(CLUSTER_GRID_TARGET);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, cluster_texture);
+    gl_state.active_texture(LIGHT_INDEX_TARGET);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, light_index_texture);
+
+    /* torch flicker is evaluated in the shader */
+    uniform("uTime", (float) glfwGetTime());
     render_quad();
+}
 
-	/* blit depth buffer */
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, gbuffer);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hdr_fbo); 
-	glBlitFramebuffer(0, 0, g_screen_width, g_screen_height, 0, 0, g_screen_width, g_screen_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-
-	/* forward shading pass */
+void Renderer::forward_pass()
+{
     use_shader(BILLBOARD_SHADER);
-	glm::mat4 vp = projection * view;
-	uniform(ShaderProgram::VP, 1, false, glm::value_ptr(vp));
-	uniform(ShaderProgram::VIEW, 1, false, glm::value_ptr(view));
 
     for (int i = 0; i < render_queue.size(); i++) {
-		if (render_queue[i]->is_opaque()) continue;
+        if (render_queue[i]->is_opaque()) continue;
         render_queue[i]->draw(*this);
     }
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void Renderer::SSAO_pass()
+void Renderer::SSAO_pass(GLuint depth, GLuint normal)
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     use_shader(SSAO_SHADER);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, ssao_fbo);
-    uniform(ShaderProgram::PROJECTION, 1, false, glm::value_ptr(projection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, g_position);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, g_normal);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, ssao_noise_texture);
-
-    for (GLuint i = 0; i < 64; ++i)
-        glUniform3fv(glGetUniformLocation(shaders[SSAO_SHADER]->get_program(), ("uSamples[" + std::to_string(i) + "]").c_str()), 1, &ssao_kernel[i][0]);
-
+    uniform("uSSAOSamples", g_ssao_samples);
+
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, depth);
+    gl_state.active_texture(GL_TEXTURE1);
+    gl_state.bind_texture(GL_TEXTURE_2D, normal);
+    gl_state.active_texture(GL_TEXTURE2);
+    gl_state.bind_texture(GL_TEXTURE_2D, ssao_noise_texture);
     render_quad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, ssao_blur_fbo);
-    glClear(GL_COLOR_BUFFER_BIT);
-   use_shader(SSAO_BLUR_SHADER);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, ssao_color_buffer);
+void Renderer::SSAO_upsample_pass(GLuint ssao, GLuint depth, GLuint normal)
+{
+    /* depth and normal aware upsample, also smooths out the noise pattern */
+    use_shader(SSAO_UPSAMPLE_SHADER);
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, ssao);
+    gl_state.active_texture(GL_TEXTURE1);
+    gl_state.bind_texture(GL_TEXTURE_2D, depth);
+    gl_state.active_texture(GL_TEXTURE2);
+    gl_state.bind_texture(GL_TEXTURE_2D, normal);
     render_quad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Renderer::shadow_map_pass()
 {
-    glm::vec3 lightPos = lights[shadow_map_light_index].position;
-
-    float aspect = (float) SHADOW_WIDTH / (float) SHADOW_HEIGHT;
-    glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), aspect, SHADOW_NEAR, SHADOW_FAR);
-    std::vector<glm::mat4> shadowTransforms;
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 1.0,  0.0,  0.0), glm::vec3(0.0, -1.0,  0.0)));
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0,  0.0,  0.0), glm::vec3(0.0, -1.0,  0.0)));
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,  1.0,  0.0), glm::vec3(0.0,  0.0,  1.0)));
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0, -1.0,  0.0), glm::vec3(0.0,  0.0, -1.0)));
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,  0.0,  1.0), glm::vec3(0.0, -1.0,  0.0)));
-    shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,  0.0, -1.0), glm::vec3(0.0, -1.0,  0.0)));
-
-    glBindFramebuffer(GL_FRAMEBUFFER, depth_map_fbo);
-    glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+    bool paraboloid = g_shadow_technique == ShadowTechnique::DUAL_PARABOLOID;
     use_shader(DEPTH_MAP_SHADER);
-    update_mvp();
-    glClear(GL_DEPTH_BUFFER_BIT);
-    for (GLuint i = 0; i < 6; ++i)
-        glUniformMatrix4fv(glGetUniformLocation(shaders[DEPTH_MAP_SHADER]->get_program(), ("uShadowMatrices[" + std::to_string(i) + "]").c_str()), 1, GL_FALSE, glm::value_ptr(shadowTransforms[i]));
     uniform("uFarPlane", SHADOW_FAR);
-    uniform("uLightPos", lightPos[0], lightPos[1], lightPos[2]);
+    uniform("uShadowParaboloid", (int) paraboloid);
+    /* the paraboloid warp cannot clip at the hemisphere boundary by itself */
+    if (paraboloid) gl_state.enable(GL_CLIP_DISTANCE0);
+
+    /* static casters are only drawn for the lights whose tiles are not in the cache */
+    bool cache_miss = false;
+    for (auto& slot : shadow_slots) {
+        if (!slot.cached) cache_miss = true;
+    }
 
-    for (int i = 0; i < render_queue.size(); i++) {
-		if (!render_queue[i]->is_opaque()) continue;
-        render_queue[i]->draw(*this);
+    if (cache_miss) {
+        gl_state.bind_framebuffer(GL_FRAMEBUFFER, static_shadow_atlas_fbo);
+        gl_state.enable(GL_SCISSOR_TEST);
+        for (auto& slot : shadow_slots) {
+            if (slot.cached) continue;
+            for (int i = 0; i < num_shadow_faces; i++) {
+                glScissor(slot.face_offsets[i].x, slot.face_offsets[i].y, slot.face_size, slot.face_size);
+                glClear(GL_DEPTH_BUFFER_BIT);
+            }
+        }
+        gl_state.disable(GL_SCISSOR_TEST);
+
+        replay_shadow_faces(RenderQueue::STATIC_SHADOW_PASS);
+
+        for (auto& slot : shadow_slots) {
+            if (!slot.cached) cache_shadow_slot(slot);
+        }
+    }
+
+    size_t begin, end;
+    command_queue.get_pass_batches(RenderQueue::SHADOW_PASS, begin, end);
+    if (begin == end) {
+        /* nothing moving in range, sample the static atlas directly */
+        shadow_map = static_shadow_atlas;
+    } else {
+        /* start from the static depth and add the dynamic casters on top */
+        gl_state.bind_framebuffer(GL_READ_FRAMEBUFFER, static_shadow_atlas_fbo);
+        gl_state.bind_framebuffer(GL_DRAW_FRAMEBUFFER, shadow_atlas_fbo);
+        glBlitFramebuffer(0, 0, shadow_atlas_size.x, shadow_atlas_height, 0, 0, shadow_atlas_size.x, shadow_atlas_height,
+                          GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+        gl_state.bind_framebuffer(GL_FRAMEBUFFER, shadow_atlas_fbo);
+        replay_shadow_faces(RenderQueue::SHADOW_PASS);
+        shadow_map = shadow_atlas;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+    if (paraboloid) gl_state.disable(GL_CLIP_DISTANCE0);
 
     glViewport(0, 0, g_screen_width, g_screen_height);
+
+    upload_shadow_data();
 }
 
-void Renderer::post_process_pass()
+void Renderer::replay_shadow_faces(RenderQueue::Pass pass)
 {
-	use_shader(GAUSSIAN_BLUR_SHADER);
-	GLboolean horizontal = true, first_iteration = true;
-	GLuint amount = 10;
-	for (GLuint i = 0; i < amount; i++)
-	{
-		glBindFramebuffer(GL_FRAMEBUFFER, bloom_blur_fbo[horizontal]);
-		uniform("uHorizontal", (int)horizontal);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(
-			GL_TEXTURE_2D, first_iteration ? hdr_buffers[1] : bloom_blur_buffers[!horizontal]
-			);
-		render_quad();
-		horizontal = !horizontal;
-		if (first_iteration)
-			first_iteration = false;
-	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	use_shader(HDR_BLEND_SHADER);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, hdr_buffers[0]);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, bloom_blur_buffers[horizontal]);
-
-	render_quad();
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    size_t begin, end;
+    command_queue.get_pass_batches(pass, begin, end);
+
+    /* batches are sorted by atlas tile, draw each run into its own viewport */
+    while (begin < end) {
+        int tile = command_queue.get_batch_material(begin);
+        size_t tile_end = begin + 1;
+        while (tile_end < end && command_queue.get_batch_material(tile_end) == tile) tile_end++;
+
+        const ShadowSlot& slot = shadow_slots[tile / MAX_SHADOW_FACES];
+        int face = tile % MAX_SHADOW_FACES;
+        /* cached tiles keep their static depth */
+        if (pass != RenderQueue::STATIC_SHADOW_PASS || !slot.cached) {
+            glm::vec3 light_pos = lights[slot.light].position;
+            glViewport(slot.face_offsets[face].x, slot.face_offsets[face].y, slot.face_size, slot.face_size);
+            uniform("uShadowMatrix", 1, false, glm::value_ptr(slot.transforms[face]));
+            uniform("uLightPos", light_pos.x, light_pos.y, light_pos.z);
+            replay_batches(pass, begin, tile_end);
+        }
+
+        begin = tile_end;
+    }
+}
+
+void Renderer::bloom_downsample_pass(GLuint input, const glm::ivec2& input_size, bool first_level)
+{
+    use_shader(BLOOM_DOWNSAMPLE_SHADER);
+    uniform("uTexelSize", 1.0f / input_size.x, 1.0f / input_size.y);
+    /* the first level suppresses fireflies before they spread over the chain */
+    uniform("uFirstLevel", (int)first_level);
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, input);
+    render_quad();
+}
+
+void Renderer::gaussian_blur_pass(GLuint input, bool horizontal)
+{
+    use_shader(GAUSSIAN_BLUR_SHADER);
+    uniform("uHorizontal", (int)horizontal);
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, input);
+    render_quad();
+}
+
+void Renderer::bloom_upsample_pass(GLuint input, const glm::ivec2& input_size)
+{
+    use_shader(BLOOM_UPSAMPLE_SHADER);
+    uniform("uTexelSize", 1.0f / input_size.x, 1.0f / input_size.y);
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, input);
+
+    gl_state.enable(GL_BLEND);
+    gl_state.blend_func(GL_ONE, GL_ONE);
+    render_quad();
+    gl_state.disable(GL_BLEND);
+}
+
+void Renderer::post_process_pass(GLuint hdr, GLuint bloom, int bloom_levels)
+{
+    /* bloom add, tone mapping and anti-aliasing in one full screen draw straight to the back buffer */
+    use_shader(COMPOSITE_SHADER);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, hdr);
+    if (bloom) {
+        gl_state.active_texture(GL_TEXTURE1);
+        gl_state.bind_texture(GL_TEXTURE_2D, bloom);
+        uniform("uBloomLevels", bloom_levels);
+    }
+    uniform("uTexelSize", 1.0f / g_screen_width, 1.0f / g_screen_height);
+
+    render_quad();
+}
+
+void Renderer::setup_overlay_cache()
+{
+    glGenFramebuffers(1, &overlay_cache_fbo);
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, overlay_cache_fbo);
+
+    glGenTextures(1, &overlay_cache_texture);
+    gl_state.bind_texture(GL_TEXTURE_2D, overlay_cache_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, g_screen_width, g_screen_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, overlay_cache_texture, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        THROW_EXCEPT(E_RENDER_ENGINE_ERROR, "Renderer::setup_overlay_cache()", "cannot setup overlay cache buffer");
+
+    gl_state.bind_texture(GL_TEXTURE_2D, 0);
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+    overlay_cache_valid = false;
 }
 
 void Renderer::setup_minimap()
 {
     glGenVertexArrays(1, &minimap_VAO);
-    glGenBuffers(1, &minimap_VBO);
-    glBindVertexArray(minimap_VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, minimap_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (void*)(2 * sizeof(GLfloat)));
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    minimap_stream_generation = 0;
+
+    /* the map with a margin of empty tiles so that the view never samples past the border */
+    glGenFramebuffers(1, &minimap_fbo);
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, minimap_fbo);
+
+    glGenTextures(1, &minimap_texture);
+    gl_state.bind_texture(GL_TEXTURE_2D, minimap_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, (g_map_width + 2 * MINIMAP_MARGIN) * MINIMAP_TILE_PIXELS,
+                 (g_map_height + 2 * MINIMAP_MARGIN) * MINIMAP_TILE_PIXELS, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, minimap_texture, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        THROW_EXCEPT(E_RENDER_ENGINE_ERROR, "Renderer::setup_minimap()", "cannot setup minimap buffer");
+
+    gl_state.bind_texture(GL_TEXTURE_2D, 0);
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, 0);
+    minimap_stale = true;
 }
 
-void Renderer::draw_minimap()
+void Renderer::invalidate_minimap()
+{
+    minimap_stale = true;
+    minimap_dirty_tiles.clear();
+}
+
+void Renderer::invalidate_minimap_tile(int i, int j)
+{
+    minimap_dirty_tiles.push_back(glm::ivec2(i, j));
+}
+
+/* quad of a tile in the minimap texture, in tiles with rows flipped so that the view of the
+ * player can be sampled with one quad, textured from dungeon.png like the map itself */
+static void add_minimap_tile(std::vector<GLfloat>& vertices, int i, int j)
+{
+    glm::vec2 texcs[4] = { {2.0f, 0.0f}, {2.0f, 0.0f}, {2.0f, 0.0f}, {2.0f, 0.0f} };
+    if (!(i < 0 || i >= g_map_width || j < 0 || j >= g_map_height)) {
+        char tile = g_map->get_tile(i, j);
+        if (tile == MapGenerator::Tile::Floor || tile == MapGenerator::Spawn || tile == MapGenerator::Traps ||
+            tile == MapGenerator::Torch || tile == MapGenerator::Treasure_traps || tile == MapGenerator::ClosedDoor ||
+            tile == MapGenerator::OpenDoor || tile == MapGenerator::Player || tile == MapGenerator::Corridor ||
+            tile == MapGenerator::Key) {
+            texcs[0] = {0.0f, 0.0f};
+            texcs[1] = {0.5f, 0.0f};
+            texcs[2] = {0.0f, 0.5f};
+            texcs[3] = {0.5f, 0.5f};
+        } else if (tile == MapGenerator::Tile::Wall) {
+            texcs[0] = {0.5f, 0.0f};
+            texcs[1] = {1.0f, 0.0f};
+            texcs[2] = {0.5f, 0.5f};
+            texcs[3] = {1.0f, 0.5f};
+        }
+    }
+
+    float x = i + MINIMAP_MARGIN, y = g_map_height + MINIMAP_MARGIN - 1 - j;
+    glm::vec2 positions[4] = { {x, y}, {x + 1, y}, {x, y + 1}, {x + 1, y + 1} };
+    int corners[6] = { 0, 1, 2, 1, 3, 2 };
+    for (int corner : corners) {
+        vertices.push_back(positions[corner].x);
+        vertices.push_back(positions[corner].y);
+        vertices.push_back(texcs[corner].x);
+        vertices.push_back(texcs[corner].y);
+    }
+}
+
+/* write the vertices into the stream buffer and bind the minimap VAO, returns the first vertex */
+GLint Renderer::stream_minimap_vertices(const GLfloat* vertices, GLsizei num_vertices)
 {
-    GLfloat minimap_verts[24];
+    GLsizeiptr stride = 4 * sizeof(GLfloat);
+    GLint first = stream_buffer.write(vertices, num_vertices * stride, stride) / stride;
+
+    gl_state.bind_vertex_array(minimap_VAO);
+    if (minimap_stream_generation != stream_buffer.get_generation()) {
+        minimap_stream_generation = stream_buffer.get_generation();
+        glBindBuffer(GL_ARRAY_BUFFER, stream_buffer.get_buffer());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, 0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(GLfloat)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    return first;
+}
+
+void Renderer::update_minimap_texture()
+{
+    std::vector<GLfloat> vertices;
+    if (minimap_stale) {
+        for (int i = -MINIMAP_MARGIN; i < g_map_width + MINIMAP_MARGIN; i++) {
+            for (int j = -MINIMAP_MARGIN; j < g_map_height + MINIMAP_MARGIN; j++) {
+                add_minimap_tile(vertices, i, j);
+            }
+        }
+        minimap_stale = false;
+    } else {
+        for (auto& tile : minimap_dirty_tiles) {
+            add_minimap_tile(vertices, tile.x, tile.y);
+        }
+    }
+    minimap_dirty_tiles.clear();
+    if (vertices.empty()) return;
+
+    int width = g_map_width + 2 * MINIMAP_MARGIN, height = g_map_height + 2 * MINIMAP_MARGIN;
+    GLuint target_fbo = gl_state.get_draw_framebuffer();
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, minimap_fbo);
+    glViewport(0, 0, width * MINIMAP_TILE_PIXELS, height * MINIMAP_TILE_PIXELS);
+
+    /* tiles replace what was there, no clipping to the view circle */
+    uniform("uRadius", 1e9f);
+    uniform("uCentre", 0.0f, 0.0f);
+    glm::mat4 proj = glm::ortho(0.0f, (float)width, 0.0f, (float)height);
+    uniform("uModel", 1, false, glm::value_ptr(glm::mat4()));
+    uniform("uProjection", 1, false, glm::value_ptr(proj));
+
+    MaterialTexture::create_texture("dungeon.png")->bind(Renderer::DIFFUSE_TEXTURE_TARGET);
+
+    GLint first = stream_minimap_vertices(&vertices[0], vertices.size() / 4);
+    glDrawArrays(GL_TRIANGLES, first, vertices.size() / 4);
+    gl_state.bind_vertex_array(0);
+
+    gl_state.bind_framebuffer(GL_FRAMEBUFFER, target_fbo);
+    glViewport(0, 0, g_screen_width, g_screen_height);
+
+    gl_state.bind_texture(GL_TEXTURE_2D, minimap_texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    gl_state.bind_texture(GL_TEXTURE_2D, 0);
+}
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+void Renderer::draw_minimap()
+{
+    gl_state.disable(GL_DEPTH_TEST);
+    update_minimap_texture();
 
-    glBindVertexArray(minimap_VAO);
+    gl_state.enable(GL_BLEND);
+    gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     auto pos = CHARACTER_MANAGER.main_char().get_camera().get_position();
     int si = (int)(pos[0] / Map::TILE_SIZE), sj = (int)(pos[2] / Map::TILE_SIZE);
@@ -645,84 +1527,41 @@ void Renderer::draw_minimap()
     uniform("uModel", 1, false, glm::value_ptr(model));
     uniform("uProjection", 1, false, glm::value_ptr(proj));
 
-    PMaterialTexture texture = MaterialTexture::create_texture("dungeon.png");
-    texture->bind(Renderer::DIFFUSE_TEXTURE_TARGET);
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, minimap_texture);
 
+    /* one quad of MINIMAP_SIZE tiles around the tile of the player, cell (0, 0) shows that tile */
     int hv = MINIMAP_SIZE / 2;
-    for (int i = -hv; i < hv; i++) {
-        for (int j = -hv; j < hv; j++) {
-            int index = 0;
-
-#define ADD_VERTEX(pos, texcoord) \
-    minimap_verts[index++] = pos[0]; \
-    minimap_verts[index++] = pos[1]; \
-    minimap_verts[index++] = texcoord[0]; \
-    minimap_verts[index++] = texcoord[1]; \
-
-            std::vector<glm::vec2> texcs{{2.0, 0}, {2.0, 0}, {2.0, 0}, {2.0, 0}};
-            int map_i = i + si, map_j = sj - j;
-            if (!(map_i < 0 || map_i >= g_map_width || map_j < 0 || map_j >= g_map_height)) {
-                char tile = g_map->get_tile(map_i, map_j);
-                if (tile == MapGenerator::Tile::Floor || tile == MapGenerator::Spawn || tile == MapGenerator::Traps ||
-                    tile == MapGenerator::Torch || tile == MapGenerator::Treasure_traps || tile == MapGenerator::ClosedDoor ||
-                    tile == MapGenerator::OpenDoor || tile == MapGenerator::Player || tile == MapGenerator::Corridor ||
-                    tile == MapGenerator::Key) {
-                    texcs[0] = {0.0f, 0.0f};
-                    texcs[1] = {0.5f, 0.0f};
-                    texcs[2] = {0.0f, 0.5f};
-                    texcs[3] = {0.5f, 0.5f};
-                } else if (tile == MapGenerator::Tile::Wall) {
-                    texcs[0] = {0.5f, 0.0f};
-                    texcs[1] = {1.0f, 0.0f};
-                    texcs[2] = {0.5f, 0.5f};
-                    texcs[3] = {1.0f, 0.5f};
-                }
-            }
-
-
-#define GEN_POS(i, j)  (i) * x_span, (j) * y_span
-            glm::vec2 vertices[4] = {
-                { GEN_POS(i, j) },
-                { GEN_POS(i + 1, j) },
-                { GEN_POS(i, j + 1) },
-                { GEN_POS(i + 1, j + 1) },
-            };
-
-            ADD_VERTEX(vertices[0], texcs[0]);
-            ADD_VERTEX(vertices[1], texcs[1]);
-            ADD_VERTEX(vertices[2], texcs[2]);
-
-            ADD_VERTEX(vertices[1], texcs[1]);
-            ADD_VERTEX(vertices[3], texcs[3]);
-            ADD_VERTEX(vertices[2], texcs[2]);
+    float width = g_map_width + 2 * MINIMAP_MARGIN, height = g_map_height + 2 * MINIMAP_MARGIN;
+    float u0 = (si + MINIMAP_MARGIN - hv) / width, u1 = (si + MINIMAP_MARGIN + hv) / width;
+    float v0 = (g_map_height + MINIMAP_MARGIN - 1 - sj - hv) / height, v1 = (g_map_height + MINIMAP_MARGIN - 1 - sj + hv) / height;
+    GLfloat x0 = -hv * x_span, x1 = hv * x_span, y0 = -hv * y_span, y1 = hv * y_span;
+    GLfloat minimap_verts[6][4] = {
+        { x0, y0, u0, v0 },
+        { x1, y0, u1, v0 },
+        { x0, y1, u0, v1 },
+
+        { x1, y0, u1, v0 },
+        { x1, y1, u1, v1 },
+        { x0, y1, u0, v1 }
+    };
 
-            glBindBuffer(GL_ARRAY_BUFFER, minimap_VBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(minimap_verts), minimap_verts);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GLint first = stream_minimap_vertices(&minimap_verts[0][0], 6);
+    glDrawArrays(GL_TRIANGLES, first, 6);
+    gl_state.bind_vertex_array(0);
+    gl_state.bind_texture(GL_TEXTURE_2D, 0);
 
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-        }
-    }
-
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
+    gl_state.disable(GL_BLEND);
+    gl_state.enable(GL_DEPTH_TEST);
 }
 
 void Renderer::overlay_pass()
 {
-    use_shader(TEXT_OVERLAY_SHADER);
-    glm::mat4 proj = glm::ortho(0.0f, (float)g_screen_width, 0.0f, (float)g_screen_height);
-    uniform("uProjection", 1, false, glm::value_ptr(proj));
-
-    for (int i = 0; i < overlay_queue.size(); i++) {
-        if (overlay_queue[i]->get_technique() != Overlay::Technique::TEXT) continue;
-        overlay_queue[i]->draw(*this);
-    }
-
+    /* overlays only queue their quads, the batch draws them all at once */
     for (int i = 0; i < overlay_queue.size(); i++) {
-        if (overlay_queue[i]->get_technique() != Overlay::Technique::GUI_ELEMENT) continue;
         overlay_queue[i]->draw(*this);
     }
+    overlay_batch.flush(*this);
 
     if (enable_minimap) {
         use_shader(MINIMAP_SHADER);
@@ -3,6 +3,7 @@
 //
 
 #include "shader_program.h"
+#include "renderer.h"
 #include "log_manager.h"
 #include "exception.h"
 
@@ -12,7 +13,8 @@
 
 using namespace std;
 
-ShaderProgram::ShaderProgram(const char * vertexPath, const char* fragmentPath, const char* geometryPath)
+ShaderProgram::ShaderProgram(const char * vertexPath, const char* fragmentPath, const char* geometryPath,
+                             const std::vector<std::string>& defines)
 {
     string vertexCode;
     string fragmentCode;
@@ -33,8 +35,8 @@ ShaderProgram::ShaderProgram(const char * vertexPath, const char* fragmentPath,
         vShaderFile.close();
         fShaderFile.close();
 
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+        vertexCode = add_defines(vShaderStream.str(), defines);
+        fragmentCode = add_defines(fShaderStream.str(), defines);
     }
     catch (ifstream::failure e) {
         THROW_EXCEPT(E_FILE_NOT_FOUND, "ShaderProgram::ShaderProgram()", "shader file is not successfully read");
@@ -85,7 +87,7 @@ ShaderProgram::ShaderProgram(const char * vertexPath, const char* fragmentPath,
             gShaderStream << gShaderFile.rdbuf();
 
             gShaderFile.close();
-            geometryCode = gShaderStream.str();
+            geometryCode = add_defines(gShaderStream.str(), defines);
         }
         catch (ifstream::failure e) {
             THROW_EXCEPT(E_FILE_NOT_FOUND, "ShaderProgram::ShaderProgram()", "shader file is not successfully read");
@@ -132,6 +134,24 @@ ShaderProgram::ShaderProgram(const char * vertexPath, const char* fragmentPath,
     if (geometryPath) glDeleteShader(geom);
 }
 
+string ShaderProgram::add_defines(const string& code, const vector<string>& defines)
+{
+    if (defines.empty()) return code;
+
+    string define_lines;
+    for (auto& define : defines) {
+        define_lines += "#define " + define + "\n";
+    }
+
+    /* #version must stay the first directive */
+    size_t pos = code.find("#version");
+    if (pos == string::npos) return define_lines + code;
+
+    pos = code.find('\n', pos);
+    if (pos == string::npos) return code + "\n" + define_lines;
+    return code.substr(0, pos + 1) + define_lines + code.substr(pos + 1);
+}
+
 void ShaderProgram::uniform(UniformID id, float v0, float v1, float v2, float v3)
 {
     Binding b = get_uniform_binding(id);
@@ -160,12 +180,20 @@ void ShaderProgram::uniform(UniformID id, GLsizei count, GLboolean transpose, co
 
 void ShaderProgram::bind()
 {
-    glUseProgram(program);
+    GL_STATE.use_program(program);
 }
 
 void ShaderProgram::unbind()
 {
-    glUseProgram(0);
+    GL_STATE.use_program(0);
+}
+
+void ShaderProgram::bind_uniform_block(const char* name, GLuint binding)
+{
+    GLuint index = glGetUniformBlockIndex(program, name);
+    if (index == GL_INVALID_INDEX) return;
+
+    glUniformBlockBinding(program, index, binding);
 }
 
 ShaderProgram::Binding ShaderProgram::get_uniform_binding(UniformID id)
@@ -214,6 +242,10 @@ void ShaderProgram::uniform(const ShaderProgram::Binding& b, int i0)
             glUniform1i(id, i0);
             break;
         case GL_SAMPLER_CUBE:
+            glUniform1i(id, i0);
+            break;
+        case GL_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_BUFFER:
             glUniform1i(id, i0);
             break;
 		case GL_BOOL:
@@ -0,0 +1,151 @@
+#include "stream_buffer.h"
+#include "log_manager.h"
+
+#include <cstring>
+
+StreamBuffer::StreamBuffer(GLsizeiptr region_size) : buffer(0), generation(0), region_size(region_size), persistent(false),
+                                                     mapping(nullptr), region(0), head(0)
+{
+    for (int i = 0; i < NUM_REGIONS; i++) fences[i] = 0;
+}
+
+void StreamBuffer::setup()
+{
+#ifdef GL_ARB_buffer_storage
+    persistent = GLAD_GL_ARB_buffer_storage != 0;
+#endif
+    LOG.info("STREAM_BUFFER::%s", persistent ? "persistent mapping" : "unsynchronized mapping with orphaning");
+
+    glGenBuffers(1, &buffer);
+    allocate();
+}
+
+void StreamBuffer::allocate()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+#ifdef GL_ARB_buffer_storage
+    if (persistent) {
+        /* immutable storage cannot be orphaned, a larger buffer needs a new name */
+        if (mapping) {
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        }
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, region_size * NUM_REGIONS, NULL, flags);
+        mapping = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, region_size * NUM_REGIONS, flags);
+    } else
+#endif
+    {
+        glBufferData(GL_ARRAY_BUFFER, region_size * NUM_REGIONS, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    generation++;
+    clear_fences();
+}
+
+void StreamBuffer::restart_region()
+{
+    if (persistent) {
+        /* the draws of the earlier writes still read the region, wait until they are done */
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        GLenum status = GL_TIMEOUT_EXPIRED;
+        while (status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(fence);
+    } else {
+        /* the earlier draws keep the orphaned storage */
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, region_size * NUM_REGIONS, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        clear_fences();
+    }
+    head = 0;
+}
+
+void StreamBuffer::clear_fences()
+{
+    for (int i = 0; i < NUM_REGIONS; i++) {
+        if (fences[i]) glDeleteSync(fences[i]);
+        fences[i] = 0;
+    }
+}
+
+void StreamBuffer::begin_frame()
+{
+    region = (region + 1) % NUM_REGIONS;
+    head = 0;
+
+    GLsync& fence = fences[region];
+    if (!fence) return;
+
+    /* the region was last written NUM_REGIONS frames ago and is normally free by now */
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        if (persistent) {
+            while (status == GL_TIMEOUT_EXPIRED) {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+        } else {
+            /* hand the driver a new storage instead of waiting for the draws */
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferData(GL_ARRAY_BUFFER, region_size * NUM_REGIONS, NULL, GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            clear_fences();
+            return;
+        }
+    }
+
+    glDeleteSync(fence);
+    fence = 0;
+}
+
+void StreamBuffer::end_frame()
+{
+    if (fences[region]) glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr StreamBuffer::write(const void* data, GLsizeiptr size, GLsizeiptr stride)
+{
+    GLintptr base = region * region_size;
+    GLintptr offset = (base + head + stride - 1) / stride * stride;
+
+    if (offset + size > base + region_size) {
+        /* the stride may be needed to align the start of the region */
+        GLsizeiptr needed = size + stride;
+        if (needed > region_size) {
+            while (region_size < needed) region_size *= 2;
+            allocate();
+            LOG.debug("STREAM_BUFFER::grown to %d bytes per region", (int)region_size);
+        } else {
+            restart_region();
+        }
+
+        base = region * region_size;
+        offset = (base + stride - 1) / stride * stride;
+    }
+
+    if (persistent) {
+        memcpy(mapping + offset, data, size);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        void* range = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (range) {
+            memcpy(range, data, size);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    head = offset + size - base;
+    return offset;
+}
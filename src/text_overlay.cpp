@@ -1,157 +1,583 @@
 #include "text_overlay.h"
 #include "exception.h"
+#include "config.h"
+#include "log_manager.h"
+#include "overlay_batch.h"
 
-#include <map>
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
 using std::string;
 
-struct Character {
-    GLuint texture_id;
+/* glyphs are stored as signed distance fields so one atlas serves every text scale
+ *
+ * a glyph is rasterized by FreeType at SDF_UPSCALE times the field resolution, the distance
+ * transform of the coverage mask is then sampled down into a fixed size atlas cell. texel
+ * values map the signed distance to the outline, 0.5 on the edge and SDF_SPREAD field texels
+ * to either side. printable ASCII is always resident, every other code point is rasterized
+ * on first use and the cell used longest ago is evicted when the atlas runs out of cells. */
+static const int FONT_SIZE = 48;
+static const int SDF_GLYPH_SIZE = 32;
+static const int SDF_SPREAD = 4;
+static const int SDF_UPSCALE = 4;
+static const int CELL_SIZE = 48;
+static const int ATLAS_SIZE = 1024;
+static const int CELLS_PER_ROW = ATLAS_SIZE / CELL_SIZE;
+static const int NUM_CELLS = CELLS_PER_ROW * CELLS_PER_ROW;
+
+static const char CACHE_MAGIC[4] = { 'D', 'S', 'D', 'F' };
+static const uint32_t CACHE_VERSION = 2;
+
+struct Glyph {
+    int cell;
+    /* field texels covered in the cell and the offset of the top left corner from the pen
+     * position, both including the spread */
     glm::ivec2 size;
     glm::ivec2 bearing;
-    GLuint advance;
+    /* field texels */
+    float advance;
 };
 
-static std::map <GLchar, Character> characters;
-static GLuint text_VAO, text_VBO;
+struct AtlasCell {
+    uint32_t code;
+    /* id of the last batch the glyph was queued in, doubles as the recency for eviction */
+    unsigned int batch;
+    bool pinned;
+};
+
+static FT_Library ft;
+static FT_Face face = nullptr;
+static std::string font_path, cache_path;
+/* the cache belongs to the font file with this size and content hash */
+static uint64_t font_file_size = 0, font_file_hash = 0;
+
+static std::unordered_map<uint32_t, Glyph> glyphs;
+/* the glyph in each cell, only meaningful for the cells not in free_cells */
+static std::vector<AtlasCell> atlas_cells(NUM_CELLS);
+static std::vector<int> free_cells;
+/* CPU copy of the atlas for the disk cache */
+static std::vector<GLubyte> atlas_pixels;
+static bool cache_dirty = false;
+static unsigned int current_batch = 0;
+/* bumped on every eviction, the cached quads of a text are stale once it changes */
+static unsigned int atlas_generation = 0;
+
+static GLuint glyph_atlas;
+
+/* next code point of an UTF-8 string, malformed sequences decode to U+FFFD */
+static uint32_t decode_utf8(const std::string& text, size_t& i)
+{
+    unsigned char lead = text[i++];
+    if (lead < 0x80) return lead;
+
+    int length;
+    uint32_t code;
+    if ((lead & 0xE0) == 0xC0) { length = 1; code = lead & 0x1F; }
+    else if ((lead & 0xF0) == 0xE0) { length = 2; code = lead & 0x0F; }
+    else if ((lead & 0xF8) == 0xF0) { length = 3; code = lead & 0x07; }
+    else return 0xFFFD;
+
+    for (int j = 0; j < length; j++) {
+        if (i >= text.size() || (text[i] & 0xC0) != 0x80) return 0xFFFD;
+        code = (code << 6) | (text[i++] & 0x3F);
+    }
+    return code;
+}
+
+static int floor_div(int a, int b)
+{
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+/* squared euclidean distance transform of one row or column (Felzenszwalb & Huttenlocher) */
+static void distance_transform_1d(const float* f, float* d, int n, int* v, float* z)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -1e20f;
+    z[1] = 1e20f;
+    for (int q = 1; q < n; q++) {
+        float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+        while (s <= z[k]) {
+            k--;
+            s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = 1e20f;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[k + 1] < q) k++;
+        d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+/* grid holds 0 on the features and a large value elsewhere, replaced by the squared distances */
+static void distance_transform(std::vector<float>& grid, int width, int height)
+{
+    int n = std::max(width, height);
+    std::vector<float> f(n), d(n), z(n + 1);
+    std::vector<int> v(n);
+
+    for (int x = 0; x < width; x++) {
+        for (int y = 0; y < height; y++) f[y] = grid[y * width + x];
+        distance_transform_1d(&f[0], &d[0], height, &v[0], &z[0]);
+        for (int y = 0; y < height; y++) grid[y * width + x] = d[y];
+    }
+    for (int y = 0; y < height; y++) {
+        distance_transform_1d(&grid[y * width], &d[0], width, &v[0], &z[0]);
+        std::copy(d.begin(), d.begin() + width, grid.begin() + y * width);
+    }
+}
+
+static void upload_cell(int cell)
+{
+    int x = (cell % CELLS_PER_ROW) * CELL_SIZE, y = (cell / CELLS_PER_ROW) * CELL_SIZE;
+
+    GL_STATE.bind_texture(GL_TEXTURE_2D, glyph_atlas);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, ATLAS_SIZE);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, CELL_SIZE, CELL_SIZE, GL_RED, GL_UNSIGNED_BYTE, &atlas_pixels[y * ATLAS_SIZE + x]);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    GL_STATE.bind_texture(GL_TEXTURE_2D, 0);
+}
+
+/* load a code point into the face and fill in the metrics of its glyph, false if the font cannot
+ * load it */
+static bool load_glyph(uint32_t code, Glyph& glyph)
+{
+    if (FT_Load_Char(face, code, FT_LOAD_RENDER)) {
+        LOG.warn("TEXT_OVERLAY::failed to load glyph U+%04X, it is not drawn", code);
+        return false;
+    }
+
+    FT_GlyphSlot slot = face->glyph;
+    int rows = slot->bitmap.rows, width = slot->bitmap.width;
+
+    /* field box aligned to the field texels around the high resolution bitmap */
+    int left = floor_div(slot->bitmap_left, SDF_UPSCALE) - SDF_SPREAD;
+    int top = -floor_div(-slot->bitmap_top, SDF_UPSCALE) + SDF_SPREAD;
+    int right = -floor_div(-(slot->bitmap_left + width), SDF_UPSCALE) + SDF_SPREAD;
+    int bottom = floor_div(slot->bitmap_top - rows, SDF_UPSCALE) - SDF_SPREAD;
+
+    glyph.size = glm::ivec2(std::min(right - left, CELL_SIZE), std::min(top - bottom, CELL_SIZE));
+    glyph.bearing = glm::ivec2(left, top);
+    glyph.advance = slot->advance.x / 64.0f / SDF_UPSCALE;
+    if (glyph.size.x < right - left || glyph.size.y < top - bottom) {
+        LOG.warn("TEXT_OVERLAY::glyph U+%04X does not fit into an atlas cell", code);
+    }
+    return true;
+}
+
+/* rasterize the distance field of the glyph loaded into the face into a cell of the atlas */
+static void rasterize_glyph(int cell, Glyph& glyph)
+{
+    FT_GlyphSlot slot = face->glyph;
+    FT_Bitmap& bitmap = slot->bitmap;
+    int rows = bitmap.rows, width = bitmap.width;
+    int left = glyph.bearing.x, top = glyph.bearing.y;
+    glyph.cell = cell;
+
+    /* distances to the outline measured from both sides of the coverage mask */
+    int hi_width = glyph.size.x * SDF_UPSCALE, hi_height = glyph.size.y * SDF_UPSCALE;
+    int offset_x = slot->bitmap_left - left * SDF_UPSCALE, offset_y = top * SDF_UPSCALE - slot->bitmap_top;
+    std::vector<float> to_inside(hi_width * hi_height), to_outside(hi_width * hi_height);
+    for (int y = 0; y < hi_height; y++) {
+        for (int x = 0; x < hi_width; x++) {
+            int bx = x - offset_x, by = y - offset_y;
+            bool inside = bx >= 0 && bx < width && by >= 0 && by < rows && bitmap.buffer[by * bitmap.pitch + bx] >= 128;
+            to_inside[y * hi_width + x] = inside ? 0.0f : 1e20f;
+            to_outside[y * hi_width + x] = inside ? 1e20f : 0.0f;
+        }
+    }
+    distance_transform(to_inside, hi_width, hi_height);
+    distance_transform(to_outside, hi_width, hi_height);
+
+    int cell_x = (cell % CELLS_PER_ROW) * CELL_SIZE, cell_y = (cell / CELLS_PER_ROW) * CELL_SIZE;
+    for (int y = 0; y < CELL_SIZE; y++) {
+        for (int x = 0; x < CELL_SIZE; x++) {
+            GLubyte value = 0;
+            if (x < glyph.size.x && y < glyph.size.y) {
+                int sample = (y * SDF_UPSCALE + SDF_UPSCALE / 2) * hi_width + x * SDF_UPSCALE + SDF_UPSCALE / 2;
+                float distance = (sqrt(to_outside[sample]) - sqrt(to_inside[sample])) / SDF_UPSCALE;
+                value = (GLubyte)(glm::clamp(0.5f + distance / (2.0f * SDF_SPREAD), 0.0f, 1.0f) * 255.0f);
+            }
+            atlas_pixels[(cell_y + y) * ATLAS_SIZE + cell_x + x] = value;
+        }
+    }
+
+    upload_cell(cell);
+    cache_dirty = true;
+}
+
+/* resident glyph of a code point, rasterized on a miss, NULL if the font cannot load it or the
+ * atlas is full of glyphs queued in the current batch */
+static Glyph* get_glyph(uint32_t code)
+{
+    auto it = glyphs.find(code);
+    if (it != glyphs.end()) {
+        atlas_cells[it->second.cell].batch = current_batch;
+        return &it->second;
+    }
+
+    /* load before taking a cell so that a missing glyph does not evict anything */
+    Glyph loaded;
+    if (!load_glyph(code, loaded)) return nullptr;
+
+    int cell;
+    if (!free_cells.empty()) {
+        cell = free_cells.back();
+        free_cells.pop_back();
+    } else {
+        /* every cell is taken, evict the unpinned one queued longest ago */
+        cell = -1;
+        for (int i = 0; i < NUM_CELLS; i++) {
+            if (atlas_cells[i].pinned) continue;
+            if (cell < 0 || atlas_cells[i].batch < atlas_cells[cell].batch) cell = i;
+        }
+
+        /* the quads of a glyph queued in this batch still point at its cell */
+        if (cell < 0 || atlas_cells[cell].batch == current_batch) {
+            LOG.warn("TEXT_OVERLAY::glyph atlas is full, U+%04X is not drawn", code);
+            return nullptr;
+        }
+
+        glyphs.erase(atlas_cells[cell].code);
+        atlas_generation++;
+    }
+
+    Glyph& glyph = glyphs[code];
+    glyph = loaded;
+    rasterize_glyph(cell, glyph);
+    atlas_cells[cell].code = code;
+    atlas_cells[cell].batch = current_batch;
+    atlas_cells[cell].pinned = false;
+    return &glyph;
+}
+
+/* metrics of a code point without touching the atlas, false if the font cannot load it */
+static bool measure_glyph(uint32_t code, Glyph& glyph)
+{
+    auto it = glyphs.find(code);
+    if (it != glyphs.end()) {
+        glyph = it->second;
+        return true;
+    }
+    return load_glyph(code, glyph);
+}
+
+/* size and FNV-1a hash of the font file */
+static void hash_font_file(uint64_t& size, uint64_t& hash)
+{
+    size = 0;
+    hash = 14695981039346656037ull;
+
+    std::ifstream file(font_path.c_str(), std::ios::binary);
+    char buf[4096];
+    while (file.read(buf, sizeof(buf)) || file.gcount() > 0) {
+        for (std::streamsize i = 0; i < file.gcount(); i++) {
+            hash = (hash ^ (unsigned char)buf[i]) * 1099511628211ull;
+        }
+        size += file.gcount();
+    }
+}
+
+/* the cache is stored little endian with fixed width fields whatever the host layout */
+static bool read_value(std::istream& stream, uint64_t& value, int bytes = 4)
+{
+    unsigned char buf[8];
+    if (!stream.read((char*)buf, bytes)) return false;
+
+    value = 0;
+    for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | buf[i];
+    return true;
+}
+
+static bool read_u32(std::istream& stream, uint32_t& value)
+{
+    uint64_t v;
+    if (!read_value(stream, v)) return false;
+    value = (uint32_t)v;
+    return true;
+}
+
+static bool read_i32(std::istream& stream, int& value)
+{
+    uint32_t v;
+    if (!read_u32(stream, v)) return false;
+    value = (int32_t)v;
+    return true;
+}
+
+static bool read_u64(std::istream& stream, uint64_t& value)
+{
+    return read_value(stream, value, 8);
+}
+
+static void write_value(std::ostream& stream, uint64_t value, int bytes = 4)
+{
+    unsigned char buf[8];
+    for (int i = 0; i < bytes; i++) buf[i] = (unsigned char)(value >> (8 * i));
+    stream.write((const char*)buf, bytes);
+}
+
+static void write_u32(std::ostream& stream, uint32_t value)
+{
+    write_value(stream, value);
+}
+
+static void write_i32(std::ostream& stream, int value)
+{
+    write_value(stream, (uint32_t)value);
+}
+
+static void write_u64(std::ostream& stream, uint64_t value)
+{
+    write_value(stream, value, 8);
+}
+
+/* fill the atlas from the disk cache, false if there is no cache for this font and layout */
+static bool load_cache()
+{
+    std::ifstream file(cache_path.c_str(), std::ios::binary);
+    if (!file) return false;
+
+    char magic[4];
+    uint32_t version, glyph_size, spread, atlas_size, cell_size, num_glyphs;
+    uint64_t font_size, font_hash;
+    if (!file.read(magic, 4) || !std::equal(magic, magic + 4, CACHE_MAGIC) ||
+        !read_u32(file, version) || version != CACHE_VERSION ||
+        !read_u32(file, glyph_size) || glyph_size != SDF_GLYPH_SIZE ||
+        !read_u32(file, spread) || spread != SDF_SPREAD ||
+        !read_u32(file, atlas_size) || atlas_size != ATLAS_SIZE ||
+        !read_u32(file, cell_size) || cell_size != CELL_SIZE ||
+        !read_u64(file, font_size) || font_size != font_file_size ||
+        !read_u64(file, font_hash) || font_hash != font_file_hash ||
+        !read_u32(file, num_glyphs) || num_glyphs > NUM_CELLS) {
+        LOG.info("TEXT_OVERLAY::glyph cache %s is stale", cache_path.c_str());
+        return false;
+    }
+
+    std::vector<bool> used(NUM_CELLS, false);
+    for (uint32_t i = 0; i < num_glyphs; i++) {
+        uint32_t code;
+        int advance;
+        Glyph glyph;
+        if (!read_u32(file, code) || !read_i32(file, glyph.cell) ||
+            !read_i32(file, glyph.size.x) || !read_i32(file, glyph.size.y) ||
+            !read_i32(file, glyph.bearing.x) || !read_i32(file, glyph.bearing.y) || !read_i32(file, advance) ||
+            glyph.cell < 0 || glyph.cell >= NUM_CELLS || used[glyph.cell]) {
+            glyphs.clear();
+            return false;
+        }
+        glyph.advance = advance / 64.0f / SDF_UPSCALE;
+        used[glyph.cell] = true;
+        glyphs[code] = glyph;
+    }
+    if (!file.read((char*)&atlas_pixels[0], atlas_pixels.size())) {
+        glyphs.clear();
+        return false;
+    }
+
+    LOG.info("TEXT_OVERLAY::loaded %u glyphs from %s", num_glyphs, cache_path.c_str());
+    return true;
+}
+
+void TextOverlay::save_font_cache()
+{
+    if (!cache_dirty) return;
+
+    std::ofstream file(cache_path.c_str(), std::ios::binary);
+    if (!file) {
+        LOG.warn("TEXT_OVERLAY::cannot write glyph cache %s", cache_path.c_str());
+        return;
+    }
+
+    file.write(CACHE_MAGIC, 4);
+    write_u32(file, CACHE_VERSION);
+    write_u32(file, SDF_GLYPH_SIZE);
+    write_u32(file, SDF_SPREAD);
+    write_u32(file, ATLAS_SIZE);
+    write_u32(file, CELL_SIZE);
+    write_u64(file, font_file_size);
+    write_u64(file, font_file_hash);
+    write_u32(file, glyphs.size());
+    for (auto& entry : glyphs) {
+        const Glyph& glyph = entry.second;
+        write_u32(file, entry.first);
+        write_i32(file, glyph.cell);
+        write_i32(file, glyph.size.x);
+        write_i32(file, glyph.size.y);
+        write_i32(file, glyph.bearing.x);
+        write_i32(file, glyph.bearing.y);
+        /* the 26.6 advance FreeType measured at the upscaled size, exact */
+        write_i32(file, (int)floor(glyph.advance * 64.0f * SDF_UPSCALE + 0.5f));
+    }
+    file.write((const char*)&atlas_pixels[0], atlas_pixels.size());
+
+    cache_dirty = false;
+    LOG.info("TEXT_OVERLAY::glyph cache written to %s", cache_path.c_str());
+}
 
 void TextOverlay::setup_font(const std::string& name)
 {
     // FreeType
-    FT_Library ft;
     // All functions return a value different than 0 whenever an error occurred
     if (FT_Init_FreeType(&ft))
         THROW_EXCEPT(ExceptionCode::E_RESOURCE_ERROR, "setup_font()", "could not init FreeType library");
 
-    // Load font as face
-    FT_Face face;
-    if (FT_New_Face(ft, ("resources/fonts/" + name + ".ttf").c_str(), 0, &face))
+    // Load font as face, it is kept open to rasterize glyphs on first use
+    font_path = "resources/fonts/" + name + ".ttf";
+    cache_path = "resources/fonts/" + name + ".sdf";
+    if (FT_New_Face(ft, font_path.c_str(), 0, &face))
         THROW_EXCEPT(ExceptionCode::E_RESOURCE_ERROR, "setup_font()", "failed to load font '" + name + "'");
 
     // Set size to load glyphs as
-    FT_Set_Pixel_Sizes(face, 0, 48);
+    FT_Set_Pixel_Sizes(face, 0, SDF_GLYPH_SIZE * SDF_UPSCALE);
+
+    atlas_pixels.assign(ATLAS_SIZE * ATLAS_SIZE, 0);
+    hash_font_file(font_file_size, font_file_hash);
 
     // Disable byte-alignment restriction
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glGenTextures(1, &glyph_atlas);
+    GL_STATE.bind_texture(GL_TEXTURE_2D, glyph_atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_SIZE, ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GL_STATE.bind_texture(GL_TEXTURE_2D, 0);
 
-    // Load first 128 characters of ASCII set
-    for (GLubyte c = 0; c < 128; c++)
-    {
-        // Load character glyph
-        if (FT_Load_Char(face, c, FT_LOAD_RENDER))
-        {
-            THROW_EXCEPT(ExceptionCode::E_RESOURCE_ERROR, "setup_font()", "failed to load glyph");
-            continue;
-        }
-        // Generate texture
-        GLuint texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-        // Set texture options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // Now store character for later use
-        Character character = {
-            texture,
-            glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-            glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-            face->glyph->advance.x
-        };
-        characters.insert(std::pair<GLchar, Character>(c, character));
+    bool cached = load_cache();
+    if (cached) {
+        GL_STATE.bind_texture(GL_TEXTURE_2D, glyph_atlas);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ATLAS_SIZE, ATLAS_SIZE, GL_RED, GL_UNSIGNED_BYTE, &atlas_pixels[0]);
+        GL_STATE.bind_texture(GL_TEXTURE_2D, 0);
+    } else {
+        atlas_pixels.assign(ATLAS_SIZE * ATLAS_SIZE, 0);
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
-    // Destroy FreeType once we're finished
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft);
 
-    glGenVertexArrays(1, &text_VAO);
-    glGenBuffers(1, &text_VBO);
-    glBindVertexArray(text_VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, text_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    std::vector<bool> used(NUM_CELLS, false);
+    for (auto& entry : glyphs) {
+        AtlasCell& cell = atlas_cells[entry.second.cell];
+        used[entry.second.cell] = true;
+        cell.code = entry.first;
+        cell.batch = current_batch;
+        cell.pinned = entry.first >= 32 && entry.first < 127;
+    }
+    for (int cell = NUM_CELLS - 1; cell >= 0; cell--) {
+        if (!used[cell]) free_cells.push_back(cell);
+    }
+
+    /* printable ASCII stays resident */
+    for (uint32_t code = 32; code < 127; code++) {
+        if (glyphs.count(code)) continue;
+
+        Glyph* glyph = get_glyph(code);
+        if (glyph) atlas_cells[glyph->cell].pinned = true;
+    }
+    if (!cached) save_font_cache();
+}
+
+GLuint TextOverlay::get_atlas()
+{
+    return glyph_atlas;
+}
+
+void TextOverlay::end_batch()
+{
+    current_batch++;
 }
 
 TextOverlay::TextOverlay(const std::string& text, float x, float y, glm::vec3 color, float scale)
-    : Overlay(Overlay::Technique::TEXT), text(text), x(x), y(y), color(color), scale(scale)
+    : Overlay(Overlay::Technique::TEXT), text(text), x(x), y(y), color(color), scale(scale), dirty(true), generation(0)
 {
 
 }
 
 void TextOverlay::draw(Renderer& renderer)
 {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (dirty || generation != atlas_generation) {
+        build_vertices();
+    } else {
+        /* keep the glyphs of the cached quads resident while they are queued */
+        for (int cell : cells) atlas_cells[cell].batch = current_batch;
+    }
+
+    if (!vertices.empty()) {
+        renderer.get_overlay_batch().add_text(&vertices[0], vertices.size() / OverlayBatch::VERTEX_FLOATS);
+    }
+}
 
-    renderer.uniform("uTextColor", color.x, color.y, color.z);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(text_VAO);
+void TextOverlay::build_vertices()
+{
+    vertices.clear();
+    cells.clear();
 
+    /* field texels to screen pixels, a scale of 1 keeps the size of the former 48px glyphs */
+    float texel = scale * FONT_SIZE / SDF_GLYPH_SIZE;
     float cur_y = y, cur_x = x;
-    std::string::const_iterator c;
-    for (c = text.begin(); c != text.end(); c++)
+    size_t i = 0;
+    while (i < text.size())
     {
-        Character ch = characters[*c];
+        uint32_t code = decode_utf8(text, i);
+        const Glyph* glyph = get_glyph(code);
+        if (!glyph) continue;
+        cells.push_back(glyph->cell);
 
-        GLfloat xpos = cur_x + ch.bearing.x * scale;
-        GLfloat ypos = cur_y - (ch.size.y - ch.bearing.y) * scale;
+        GLfloat xpos = cur_x + glyph->bearing.x * texel;
+        GLfloat ypos = cur_y + (glyph->bearing.y - glyph->size.y) * texel;
 
-        GLfloat w = ch.size.x * scale;
-        GLfloat h = ch.size.y * scale;
+        GLfloat w = glyph->size.x * texel;
+        GLfloat h = glyph->size.y * texel;
 
-        GLfloat vertices[6][4] = {
-            { xpos,     ypos + h,   0.0, 0.0 },
-            { xpos,     ypos,       0.0, 1.0 },
-            { xpos + w, ypos,       1.0, 1.0 },
+        GLfloat u0 = (float)((glyph->cell % CELLS_PER_ROW) * CELL_SIZE) / ATLAS_SIZE;
+        GLfloat v0 = (float)((glyph->cell / CELLS_PER_ROW) * CELL_SIZE) / ATLAS_SIZE;
+        GLfloat u1 = u0 + (float)glyph->size.x / ATLAS_SIZE, v1 = v0 + (float)glyph->size.y / ATLAS_SIZE;
+        GLfloat quad[6][OverlayBatch::VERTEX_FLOATS] = {
+            { xpos,     ypos + h,   u0, v0, color.x, color.y, color.z },
+            { xpos,     ypos,       u0, v1, color.x, color.y, color.z },
+            { xpos + w, ypos,       u1, v1, color.x, color.y, color.z },
 
-            { xpos,     ypos + h,   0.0, 0.0 },
-            { xpos + w, ypos,       1.0, 1.0 },
-            { xpos + w, ypos + h,   1.0, 0.0 }
+            { xpos,     ypos + h,   u0, v0, color.x, color.y, color.z },
+            { xpos + w, ypos,       u1, v1, color.x, color.y, color.z },
+            { xpos + w, ypos + h,   u1, v0, color.x, color.y, color.z }
         };
+        vertices.insert(vertices.end(), &quad[0][0], &quad[0][0] + 6 * OverlayBatch::VERTEX_FLOATS);
 
-        glBindTexture(GL_TEXTURE_2D, ch.texture_id);
-        glBindBuffer(GL_ARRAY_BUFFER, text_VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        cur_x += (ch.advance >> 6) * scale; //(2^6 = 64)
+        cur_x += glyph->advance * texel;
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
 
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+    dirty = false;
+    generation = atlas_generation;
 }
 
 glm::vec2 TextOverlay::size_hint() const
 {
+    float texel = scale * FONT_SIZE / SDF_GLYPH_SIZE;
     float cur_x = 0, cur_y = 0;
-    std::string::const_iterator c;
-    for (c = text.begin(); c != text.end(); c++)
+    size_t i = 0;
+    while (i < text.size())
     {
-        Character ch = characters[*c];
+        Glyph glyph;
+        if (!measure_glyph(decode_utf8(text, i), glyph)) continue;
 
-        cur_y = (ch.size.y * scale > 0) ? ch.size.y * scale : 0;
-        cur_x += (ch.advance >> 6) * scale; //(2^6 = 64)
+        /* outline height without the spread */
+        int height = glyph.size.y - 2 * SDF_SPREAD;
+        cur_y = (height > 0) ? height * texel : 0;
+        cur_x += glyph.advance * texel;
     }
 
     return glm::vec2{cur_x, cur_y};